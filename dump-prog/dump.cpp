@@ -23,6 +23,7 @@ THE SOFTWARE.
 */
 
 #include "parse.h"
+#include <cstdio>
 #include <iostream>
 #include <sstream>
 
@@ -47,6 +48,11 @@ int printImports(void *N, VA impAddr, string &modName, string &symName) {
   return 0;
 }
 
+int printTLSCallback(void *N, VA callback) {
+  cout << "0x" << to_string<VA>(callback, hex) << endl;
+  return 0;
+}
+
 int printRelocs(void *N, VA relocAddr, reloc_type type) {
   cout << "TYPE: ";
   switch (type) {
@@ -314,8 +320,112 @@ int main(int argc, char *argv[]) {
 #undef DUMP_FIELD
 #undef DUMP_DEC_FIELD
 
+      uint32_t checksum;
+      if (ComputePEChecksum(p, checksum)) {
+        cout << "Computed CheckSum: 0x" << to_string<uint32_t>(checksum, hex);
+        cout << endl;
+      }
+
+      const rich_header &rich = p->peHeader.rich;
+      if (rich.present) {
+        cout << "Rich header: key 0x" << to_string<uint32_t>(rich.key, hex);
+        cout << (rich.checksumValid ? "" : " (checksum mismatch)") << endl;
+        for (uint32_t i = 0; i < rich.count; i++) {
+          const rich_entry &e = rich.entries[i];
+          cout << "PRODUCT: " << e.productId << " BUILD: " << e.build;
+          cout << " COUNT: " << e.count << endl;
+        }
+      }
+
       cout << "Imports: " << endl;
       IterImpVAString(p, printImports, NULL);
+      cout << "Delay imports: " << endl;
+      IterDelayImpVAString(p, printImports, NULL);
+      cout << "Bound imports: " << endl;
+      for (const boundimportent &b : GetBoundImports(p)) {
+        cout << (b.isForwarderRef ? "  " : "") << b.moduleName.str();
+        cout << " 0x" << to_string<uint32_t>(b.timeDateStamp, hex) << endl;
+      }
+      cout << "IAT: " << endl;
+      for (const iatent &i : GetIAT(p)) {
+        cout << "0x" << to_string<VA>(i.addr, hex);
+        cout << " 0x" << to_string<uint64_t>(i.value, hex) << endl;
+      }
+      pdb_info pdb;
+      if (GetPDBInfo(p, pdb)) {
+        char g[40];
+        snprintf(g,
+                 sizeof(g),
+                 "%08X%04X%04X%02X%02X%02X%02X%02X%02X%02X%02X",
+                 pdb.pdbGuid.Data1,
+                 pdb.pdbGuid.Data2,
+                 pdb.pdbGuid.Data3,
+                 pdb.pdbGuid.Data4[0],
+                 pdb.pdbGuid.Data4[1],
+                 pdb.pdbGuid.Data4[2],
+                 pdb.pdbGuid.Data4[3],
+                 pdb.pdbGuid.Data4[4],
+                 pdb.pdbGuid.Data4[5],
+                 pdb.pdbGuid.Data4[6],
+                 pdb.pdbGuid.Data4[7]);
+        cout << "PDB: " << pdb.pdbPath.str() << " " << g;
+        cout << to_string<uint32_t>(pdb.age, hex) << endl;
+      }
+      cout << "Debug directory: " << endl;
+      for (const debug_dir_entry &d : GetDebugEntries(p)) {
+        cout << "TYPE: " << d.Type << " SIZE: " << d.SizeOfData;
+        cout << " AT: 0x" << to_string<uint32_t>(d.PointerToRawData, hex);
+        cout << endl;
+      }
+      cout << "TLS callbacks: " << endl;
+      IterTLSCallbacks(p, printTLSCallback, NULL);
+      load_config_64 lc;
+      if (GetLoadConfig(p, lc)) {
+        cout << "Load config: " << endl;
+        cout << "SIZE: " << lc.Size;
+        cout << " COOKIE: 0x" << to_string<uint64_t>(lc.SecurityCookie, hex);
+        cout << " GUARD FLAGS: 0x" << to_string<uint32_t>(lc.GuardFlags, hex);
+        cout << endl;
+        cout << "CFG functions: " << GetGuardCFFunctionTable(p).size();
+        cout << " SEH handlers: " << GetSEHandlerTable(p).size() << endl;
+      }
+      clr_header clr;
+      if (GetCLRHeader(p, clr)) {
+        cout << "CLR header: runtime " << clr.MajorRuntimeVersion << ".";
+        cout << clr.MinorRuntimeVersion;
+        cout << " flags 0x" << to_string<uint32_t>(clr.Flags, hex) << endl;
+        clr_metadata md;
+        if (GetCLRMetadata(p, md)) {
+          cout << "Metadata version: " << md.version.str() << endl;
+        }
+        for (const clr_stream &s : GetCLRStreams(p)) {
+          cout << "STREAM: " << s.name.str();
+          cout << " OFFSET: 0x" << to_string<uint32_t>(s.offset, hex);
+          cout << " SIZE: " << s.data.size() << endl;
+        }
+      }
+      cout << "Certificates: " << endl;
+      for (const certificate &c : GetCertificates(p)) {
+        cout << "REVISION: 0x" << to_string<uint16_t>(c.revision, hex);
+        cout << " TYPE: " << c.type << " SIZE: " << c.data.size() << endl;
+      }
+      uint8_t digest[32];
+      if (ComputeAuthenticodeDigest(p, PE_DIGEST_SHA256, digest)) {
+        cout << "Authenticode SHA-256: ";
+        for (uint8_t b : digest) {
+          char h[3];
+          snprintf(h, sizeof(h), "%02x", b);
+          cout << h;
+        }
+        cout << endl;
+      }
+      cout << "Functions (exception directory): " << endl;
+      for (const runtime_function &f : GetFunctionTable(p)) {
+        cout << "0x" << to_string<uint32_t>(f.BeginAddress, hex);
+        cout << " - 0x" << to_string<uint32_t>(f.EndAddress, hex);
+        cout << " unwind 0x" << to_string<uint32_t>(f.UnwindInfoAddress, hex);
+        cout << endl;
+      }
       cout << "Relocations: " << endl;
       IterRelocs(p, printRelocs, NULL);
       cout << "Symbols (symbol table): " << endl;
@@ -324,6 +434,13 @@ int main(int argc, char *argv[]) {
       IterSec(p, printSecs, NULL);
       cout << "Exports: " << endl;
       IterExpVA(p, printExps, NULL);
+      cout << "Forwarded exports: " << endl;
+      for (const exportent &e : GetExports(p)) {
+        if (!e.forwarderName.empty()) {
+          cout << "FWD: " << e.moduleName.str() << "!" << e.symbolName.str();
+          cout << " -> " << e.forwarderName.str() << endl;
+        }
+      }
 
       // read the first 8 bytes from the entry point and print them
       VA entryPoint;
@@ -343,6 +460,11 @@ int main(int argc, char *argv[]) {
 
       cout << "Resources: " << endl;
       IterRsrc(p, printRsrc, NULL);
+      resource_data ver;
+      if (FindResourceData(p, RT_VERSION, 1, RESOURCE_ANY_LANG, ver)) {
+        cout << "Version resource: RVA 0x" << to_string<uint32_t>(ver.RVA, hex);
+        cout << " SIZE: " << ver.data.size() << endl;
+      }
       DestructParsedPE(p);
     } else {
       cout << "Error: " << GetPEErr() << " (" << GetPEErrString() << ")"
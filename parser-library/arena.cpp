@@ -0,0 +1,127 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013 Andrew Ruef
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#include "arena.h"
+#include <cstdlib>
+#include <string.h>
+
+namespace peparse {
+
+// the first block is small so tiny images stay cheap, later ones double
+static const std::size_t ARENA_MIN_BLOCK = 4096;
+static const std::size_t ARENA_MAX_BLOCK = 1024 * 1024;
+
+// block headers are padded so the memory after them is suitably aligned
+static const std::size_t ARENA_HEADER = 16;
+
+arena::arena()
+    : blocks(nullptr),
+      cur(nullptr),
+      end(nullptr),
+      nextBlockSize(ARENA_MIN_BLOCK) {
+}
+
+arena::~arena() {
+  release();
+}
+
+void *arena::allocateBlock(std::size_t size) {
+  if (size > static_cast<std::size_t>(-1) - ARENA_HEADER) {
+    return nullptr;
+  }
+
+  block *b = static_cast<block *>(malloc(ARENA_HEADER + size));
+
+  if (b == nullptr) {
+    return nullptr;
+  }
+
+  b->next = blocks;
+  blocks = b;
+
+  return reinterpret_cast<std::uint8_t *>(b) + ARENA_HEADER;
+}
+
+void *arena::allocate(std::size_t size, std::size_t align) {
+  if (align == 0 || align > ARENA_HEADER || (align & (align - 1)) != 0) {
+    return nullptr;
+  }
+
+  if (cur != nullptr) {
+    std::uintptr_t p = reinterpret_cast<std::uintptr_t>(cur);
+    std::uintptr_t pad = (align - (p & (align - 1))) & (align - 1);
+
+    if (pad <= static_cast<std::size_t>(end - cur) &&
+        size <= static_cast<std::size_t>(end - cur) - pad) {
+      std::uint8_t *r = cur + pad;
+      cur = r + size;
+      return r;
+    }
+  }
+
+  // big requests, like a reserve for every relocation in the image, get a
+  // block of their own so the block being bumped through isn't abandoned
+  if (size > nextBlockSize / 2) {
+    return allocateBlock(size);
+  }
+
+  std::uint8_t *b = static_cast<std::uint8_t *>(allocateBlock(nextBlockSize));
+
+  if (b == nullptr) {
+    return nullptr;
+  }
+
+  cur = b + size;
+  end = b + nextBlockSize;
+
+  if (nextBlockSize < ARENA_MAX_BLOCK) {
+    nextBlockSize *= 2;
+  }
+
+  return b;
+}
+
+char *arena::copy(const void *src, std::size_t len) {
+  char *dst = static_cast<char *>(allocate(len == 0 ? 1 : len, 1));
+
+  if (dst != nullptr && len != 0) {
+    memcpy(dst, src, len);
+  }
+
+  return dst;
+}
+
+void arena::release() {
+  while (blocks != nullptr) {
+    block *next = blocks->next;
+    free(blocks);
+    blocks = next;
+  }
+
+  cur = nullptr;
+  end = nullptr;
+  nextBlockSize = ARENA_MIN_BLOCK;
+}
+} // namespace peparse
@@ -0,0 +1,119 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013 Andrew Ruef
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+#ifndef _ARENA_H
+#define _ARENA_H
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace peparse {
+
+/*
+ * A monotonic allocator for everything a single parse produces. Memory is
+ * handed out by bumping a pointer through malloc'd blocks and is only given
+ * back when the arena is released, so the parsed data goes away with a
+ * handful of frees instead of one per object.
+ */
+class arena {
+public:
+  arena();
+  ~arena();
+
+  // returns nullptr when the memory can't be had
+  void *allocate(std::size_t size, std::size_t align);
+
+  // copy len bytes into the arena, the copy is not NUL terminated
+  char *copy(const void *src, std::size_t len);
+
+  // give back every block at once
+  void release();
+
+private:
+  arena(const arena &);
+  arena &operator=(const arena &);
+
+  struct block {
+    block *next;
+  };
+
+  void *allocateBlock(std::size_t size);
+
+  block *blocks;
+  std::uint8_t *cur;
+  std::uint8_t *end;
+  std::size_t nextBlockSize;
+};
+
+// lets the STL containers in parsed_pe_internal allocate from an arena
+template <class T>
+class arena_allocator {
+public:
+  typedef T value_type;
+
+  explicit arena_allocator(arena *a) : mem(a) {
+  }
+
+  template <class U>
+  arena_allocator(const arena_allocator<U> &other) : mem(other.mem) {
+  }
+
+  T *allocate(std::size_t n) {
+    if (n > static_cast<std::size_t>(-1) / sizeof(T)) {
+      throw std::bad_alloc();
+    }
+
+    void *p = mem->allocate(n * sizeof(T), alignof(T));
+    if (p == nullptr) {
+      throw std::bad_alloc();
+    }
+
+    return static_cast<T *>(p);
+  }
+
+  void deallocate(T *, std::size_t) {
+    // released along with the arena
+  }
+
+  arena *mem;
+};
+
+template <class T, class U>
+bool operator==(const arena_allocator<T> &a, const arena_allocator<U> &b) {
+  return a.mem == b.mem;
+}
+
+template <class T, class U>
+bool operator!=(const arena_allocator<T> &a, const arena_allocator<U> &b) {
+  return a.mem != b.mem;
+}
+
+// containers whose memory comes from the parse arena
+template <class T>
+using arena_vector = std::vector<T, arena_allocator<T>>;
+} // namespace peparse
+
+#endif
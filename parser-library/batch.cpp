@@ -0,0 +1,264 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013 Andrew Ruef
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "parse.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+using namespace std;
+
+namespace peparse {
+
+namespace {
+
+/*
+ * The items of one worker. Each worker sorts its own queue largest first
+ * before it starts, so the owner takes from the front to start on its
+ * biggest item and thieves take from the back. Huge images then get going
+ * early while the small ones fill in around them.
+ */
+struct work_queue {
+  mutex lock;
+  deque<size_t> items;
+};
+
+struct batch_state {
+  const pe_batch_item *items;
+  iterBatch cb;
+  void *cbd;
+  ::uint32_t flags;
+  vector<work_queue> queues;
+  vector<::uint64_t> sizes;
+  atomic<bool> stop;
+};
+
+::uint64_t itemSize(const pe_batch_item &item) {
+  if (item.path == nullptr) {
+    return item.size;
+  }
+
+#ifdef WIN32
+  struct _stat64 s;
+
+  if (_stat64(item.path, &s) != 0) {
+    return 0;
+  }
+#else
+  struct stat s;
+
+  if (stat(item.path, &s) != 0) {
+    return 0;
+  }
+#endif
+
+  return static_cast<::uint64_t>(s.st_size);
+}
+
+// order items by decreasing size, ties keep their input order
+struct larger_first {
+  const vector<::uint64_t> &sizes;
+
+  bool operator()(size_t a, size_t b) const {
+    return sizes[a] > sizes[b] || (sizes[a] == sizes[b] && a < b);
+  }
+};
+
+/*
+ * Order a worker's queue by size. Files are stat'ed here, on each worker
+ * for its own items, rather than for the whole batch on the calling thread
+ * before any parse starts. The lock isn't held for the stats, so items
+ * stolen meanwhile are simply gone by the time the queue is sorted.
+ */
+void sortQueue(batch_state &b, size_t self) {
+  work_queue &q = b.queues[self];
+  vector<size_t> mine;
+
+  {
+    lock_guard<mutex> g(q.lock);
+    mine.assign(q.items.begin(), q.items.end());
+  }
+
+  for (size_t index : mine) {
+    b.sizes[index] = itemSize(b.items[index]);
+  }
+
+  lock_guard<mutex> g(q.lock);
+  larger_first cmp = {b.sizes};
+  sort(q.items.begin(), q.items.end(), cmp);
+}
+
+bool takeOwn(work_queue &q, size_t &index) {
+  lock_guard<mutex> g(q.lock);
+
+  if (q.items.empty()) {
+    return false;
+  }
+
+  index = q.items.front();
+  q.items.pop_front();
+  return true;
+}
+
+bool steal(batch_state &b, size_t self, size_t &index) {
+  size_t n = b.queues.size();
+
+  for (size_t i = 1; i < n; i++) {
+    work_queue &q = b.queues[(self + i) % n];
+    lock_guard<mutex> g(q.lock);
+
+    if (!q.items.empty()) {
+      index = q.items.back();
+      q.items.pop_back();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// the error an item fails with when an exception ends its parse or callback
+pe_error itemError(pe_err code) {
+  PE_ERR(code);
+  return GetPEErrInfo();
+}
+
+/*
+ * Parse an item and hand it to the callback. This runs on a worker thread,
+ * where an exception would end the process, so one only fails the item it
+ * came from.
+ */
+void parseItem(batch_state &b, size_t index) {
+  const pe_batch_item &item = b.items[index];
+  pe_error err;
+  parsed_pe *p;
+
+  try {
+    if (item.path != nullptr) {
+      p = ParsePEFromFile(item.path, err, b.flags);
+    } else {
+      p = ParsePEFromBuffer(item.buffer, item.size, err, b.flags);
+    }
+  } catch (...) {
+    p = nullptr;
+    err = itemError(PEERR_MEM);
+  }
+
+  int stop;
+  try {
+    stop = b.cb(b.cbd, index, p, err);
+  } catch (...) {
+    DestructParsedPE(p);
+    p = nullptr;
+
+    try {
+      stop = b.cb(b.cbd, index, nullptr, itemError(PEERR_CALLBACK));
+    } catch (...) {
+      stop = 0;
+    }
+  }
+
+  if (stop != 0) {
+    b.stop = true;
+  }
+
+  if (p != nullptr) {
+    DestructParsedPE(p);
+  }
+}
+
+void worker(batch_state *b, size_t self) {
+  size_t index;
+
+  sortQueue(*b, self);
+
+  // nothing is queued once the batch has started, so when every queue is
+  // empty there is no more work for anyone
+  while (!b->stop) {
+    if (!takeOwn(b->queues[self], index) && !steal(*b, self, index)) {
+      break;
+    }
+
+    parseItem(*b, index);
+  }
+}
+
+} // anonymous namespace
+
+void ParsePEBatch(const pe_batch_item *items,
+                  size_t count,
+                  ::uint32_t threads,
+                  iterBatch cb,
+                  void *cbd,
+                  ::uint32_t flags) {
+  if (items == nullptr || count == 0 || cb == nullptr) {
+    return;
+  }
+
+  size_t n = threads;
+
+  if (n == 0) {
+    n = thread::hardware_concurrency();
+  }
+
+  n = max<size_t>(1, min(n, count));
+
+  batch_state b;
+  b.items = items;
+  b.cb = cb;
+  b.cbd = cbd;
+  b.flags = flags;
+  b.queues = vector<work_queue>(n);
+  b.sizes = vector<::uint64_t>(count, 0);
+  b.stop = false;
+
+  for (size_t i = 0; i < count; i++) {
+    b.queues[i % n].items.push_back(i);
+  }
+
+  // a worker that can't be started just leaves its queue to the thieves
+  vector<thread> pool;
+  pool.reserve(n - 1);
+  for (size_t i = 1; i < n; i++) {
+    try {
+      pool.push_back(thread(worker, &b, i));
+    } catch (const system_error &) {
+      break;
+    }
+  }
+
+  worker(&b, 0);
+
+  for (thread &t : pool) {
+    t.join();
+  }
+}
+} // namespace peparse
@@ -23,6 +23,7 @@ THE SOFTWARE.
 */
 
 #include "parse.h"
+#include <cstdint>
 #include <fstream>
 #include <string.h>
 
@@ -62,9 +63,6 @@ using namespace std;
 
 namespace peparse {
 
-extern ::uint32_t err;
-extern ::string err_loc;
-
 struct buffer_detail {
 #ifdef WIN32
   HANDLE file;
@@ -74,12 +72,12 @@ struct buffer_detail {
 #endif
 };
 
-bool readByte(bounded_buffer *b, ::uint32_t offset, ::uint8_t &out) {
+bool readByte(bounded_buffer *b, ::uint64_t offset, ::uint8_t &out) {
   if (b == nullptr) {
     return false;
   }
 
-  if (offset >= b->bufLen) {
+  if (offset >= b->bufLen || b->bufLen - offset < sizeof(out)) {
     return false;
   }
 
@@ -89,58 +87,118 @@ bool readByte(bounded_buffer *b, ::uint32_t offset, ::uint8_t &out) {
   return true;
 }
 
-bool readWord(bounded_buffer *b, ::uint32_t offset, ::uint16_t &out) {
+bool readWord(bounded_buffer *b, ::uint64_t offset, ::uint16_t &out) {
   if (b == nullptr) {
     return false;
   }
 
-  if (offset >= b->bufLen) {
+  if (offset >= b->bufLen || b->bufLen - offset < sizeof(out)) {
     return false;
   }
 
-  ::uint16_t *tmp = reinterpret_cast<uint16_t *>(b->buf + offset);
+  // offsets aren't necessarily aligned
+  ::uint16_t tmp;
+  memcpy(&tmp, b->buf + offset, sizeof(tmp));
   if (b->swapBytes) {
-    out = byteSwapUint16(*tmp);
+    out = byteSwapUint16(tmp);
   } else {
-    out = *tmp;
+    out = tmp;
   }
 
   return true;
 }
 
-bool readDword(bounded_buffer *b, ::uint32_t offset, ::uint32_t &out) {
+bool readDword(bounded_buffer *b, ::uint64_t offset, ::uint32_t &out) {
   if (b == nullptr) {
     return false;
   }
 
-  if (offset >= b->bufLen) {
+  if (offset >= b->bufLen || b->bufLen - offset < sizeof(out)) {
     return false;
   }
 
-  ::uint32_t *tmp = reinterpret_cast<uint32_t *>(b->buf + offset);
+  // offsets aren't necessarily aligned
+  ::uint32_t tmp;
+  memcpy(&tmp, b->buf + offset, sizeof(tmp));
   if (b->swapBytes) {
-    out = byteSwapUint32(*tmp);
+    out = byteSwapUint32(tmp);
   } else {
-    out = *tmp;
+    out = tmp;
   }
 
   return true;
 }
 
-bool readQword(bounded_buffer *b, ::uint32_t offset, ::uint64_t &out) {
+bool readQword(bounded_buffer *b, ::uint64_t offset, ::uint64_t &out) {
   if (b == nullptr) {
     return false;
   }
 
-  if (offset >= b->bufLen) {
+  if (offset >= b->bufLen || b->bufLen - offset < sizeof(out)) {
     return false;
   }
 
-  ::uint64_t *tmp = reinterpret_cast<uint64_t *>(b->buf + offset);
+  // offsets aren't necessarily aligned
+  ::uint64_t tmp;
+  memcpy(&tmp, b->buf + offset, sizeof(tmp));
   if (b->swapBytes) {
-    out = byteSwapUint64(*tmp);
+    out = byteSwapUint64(tmp);
   } else {
-    out = *tmp;
+    out = tmp;
+  }
+
+  return true;
+}
+
+bool readFields(bounded_buffer *b,
+                ::uint64_t offset,
+                void *out,
+                ::uint32_t len,
+                ::uint32_t stride,
+                const field_desc *fields) {
+  if (b == nullptr || stride == 0) {
+    return false;
+  }
+
+  if (offset > b->bufLen || len > b->bufLen - offset) {
+    return false;
+  }
+
+  ::uint8_t *dst = reinterpret_cast<::uint8_t *>(out);
+  memcpy(dst, b->buf + offset, len);
+
+  if (!b->swapBytes) {
+    return true;
+  }
+
+  for (::uint32_t rec = 0; rec < len; rec += stride) {
+    for (const field_desc *f = fields; f->size != 0; f++) {
+      for (::uint32_t i = 0; i < f->count; i++) {
+        ::uint32_t at = rec + f->offset + (i * f->size);
+
+        if (at + f->size > len) {
+          break;
+        }
+
+        ::uint8_t *p = dst + at;
+        if (f->size == 2) {
+          ::uint16_t v;
+          memcpy(&v, p, sizeof(v));
+          v = byteSwapUint16(v);
+          memcpy(p, &v, sizeof(v));
+        } else if (f->size == 4) {
+          ::uint32_t v;
+          memcpy(&v, p, sizeof(v));
+          v = byteSwapUint32(v);
+          memcpy(p, &v, sizeof(v));
+        } else if (f->size == 8) {
+          ::uint64_t v;
+          memcpy(&v, p, sizeof(v));
+          v = byteSwapUint64(v);
+          memcpy(p, &v, sizeof(v));
+        }
+      }
+    }
   }
 
   return true;
@@ -159,9 +217,9 @@ bounded_buffer *readFileToFileBuffer(const char *filePath) {
     return nullptr;
   }
 
-  DWORD fileSize = GetFileSize(h, nullptr);
+  LARGE_INTEGER fileSize;
 
-  if (fileSize == INVALID_FILE_SIZE) {
+  if (!GetFileSizeEx(h, &fileSize)) {
     CloseHandle(h);
     return nullptr;
   }
@@ -217,7 +275,7 @@ bounded_buffer *readFileToFileBuffer(const char *filePath) {
   }
 
   p->buf = (::uint8_t *) ptr;
-  p->bufLen = fileSize;
+  p->bufLen = static_cast<::uint64_t>(fileSize.QuadPart);
 #else
   p->detail->fd = fd;
 
@@ -231,6 +289,15 @@ bounded_buffer *readFileToFileBuffer(const char *filePath) {
     return nullptr;
   }
 
+  // a file bigger than the address space can't be mapped in one piece
+  if (static_cast<::uint64_t>(s.st_size) > SIZE_MAX) {
+    close(fd);
+    delete d;
+    delete p;
+    PE_ERR(PEERR_MEM);
+    return nullptr;
+  }
+
   void *maddr = mmap(nullptr, s.st_size, PROT_READ, MAP_SHARED, fd, 0);
 
   if (maddr == MAP_FAILED) {
@@ -242,7 +309,7 @@ bounded_buffer *readFileToFileBuffer(const char *filePath) {
   }
 
   p->buf = reinterpret_cast<uint8_t *>(maddr);
-  p->bufLen = s.st_size;
+  p->bufLen = static_cast<::uint64_t>(s.st_size);
 #endif
   p->copy = false;
   p->swapBytes = false;
@@ -250,8 +317,32 @@ bounded_buffer *readFileToFileBuffer(const char *filePath) {
   return p;
 }
 
+// wrap caller owned memory in a buffer object, the memory is not released
+// by deleteBuffer and has to outlive the buffer
+bounded_buffer *makeBufferFromPointer(::uint8_t *data, ::uint64_t sz) {
+  if (data == nullptr) {
+    PE_ERR(PEERR_READ);
+    return nullptr;
+  }
+
+  bounded_buffer *p = new (std::nothrow) bounded_buffer();
+
+  if (p == nullptr) {
+    PE_ERR(PEERR_MEM);
+    return nullptr;
+  }
+
+  p->copy = true;
+  p->detail = nullptr;
+  p->buf = data;
+  p->bufLen = sz;
+  p->swapBytes = false;
+
+  return p;
+}
+
 // split buffer inclusively from from to to by offset
-bounded_buffer *splitBuffer(bounded_buffer *b, ::uint32_t from, ::uint32_t to) {
+bounded_buffer *splitBuffer(bounded_buffer *b, ::uint64_t from, ::uint64_t to) {
   if (b == nullptr) {
     return nullptr;
   }
@@ -0,0 +1,274 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013 Andrew Ruef
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include "digest.h"
+#include <cstring>
+
+namespace peparse {
+
+namespace {
+
+inline std::uint32_t rotl(std::uint32_t x, int n) {
+  return (x << n) | (x >> (32 - n));
+}
+
+inline std::uint32_t rotr(std::uint32_t x, int n) {
+  return (x >> n) | (x << (32 - n));
+}
+
+inline std::uint32_t loadBE(const std::uint8_t *p) {
+  return (static_cast<std::uint32_t>(p[0]) << 24) |
+         (static_cast<std::uint32_t>(p[1]) << 16) |
+         (static_cast<std::uint32_t>(p[2]) << 8) |
+         static_cast<std::uint32_t>(p[3]);
+}
+
+inline void storeBE(std::uint8_t *p, std::uint32_t v) {
+  p[0] = static_cast<std::uint8_t>(v >> 24);
+  p[1] = static_cast<std::uint8_t>(v >> 16);
+  p[2] = static_cast<std::uint8_t>(v >> 8);
+  p[3] = static_cast<std::uint8_t>(v);
+}
+
+const std::uint32_t sha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+} // anonymous namespace
+
+template <class H>
+void block_digest<H>::update(const std::uint8_t *data, std::size_t len) {
+  H *self = static_cast<H *>(this);
+  total += len;
+
+  // top up a block left over from the last update first
+  if (used != 0) {
+    std::size_t n = sizeof(buf) - used;
+    if (len < n) {
+      memcpy(buf + used, data, len);
+      used += len;
+      return;
+    }
+
+    memcpy(buf + used, data, n);
+    self->compress(buf, 1);
+    data += n;
+    len -= n;
+    used = 0;
+  }
+
+  std::size_t blocks = len / sizeof(buf);
+  if (blocks != 0) {
+    self->compress(data, blocks);
+    data += blocks * sizeof(buf);
+    len -= blocks * sizeof(buf);
+  }
+
+  memcpy(buf, data, len);
+  used = len;
+}
+
+template <class H>
+void block_digest<H>::finish() {
+  H *self = static_cast<H *>(this);
+  std::uint64_t bits = total * 8;
+
+  buf[used++] = 0x80;
+  if (used > sizeof(buf) - 8) {
+    memset(buf + used, 0, sizeof(buf) - used);
+    self->compress(buf, 1);
+    used = 0;
+  }
+
+  memset(buf + used, 0, sizeof(buf) - 8 - used);
+  storeBE(buf + 56, static_cast<std::uint32_t>(bits >> 32));
+  storeBE(buf + 60, static_cast<std::uint32_t>(bits));
+  self->compress(buf, 1);
+}
+
+template class block_digest<sha1>;
+template class block_digest<sha256>;
+
+sha1::sha1() {
+  state[0] = 0x67452301;
+  state[1] = 0xefcdab89;
+  state[2] = 0x98badcfe;
+  state[3] = 0x10325476;
+  state[4] = 0xc3d2e1f0;
+}
+
+void sha1::compress(const std::uint8_t *blocks, std::size_t count) {
+  std::uint32_t w[80];
+
+  for (; count != 0; count--, blocks += 64) {
+    for (int i = 0; i < 16; i++) {
+      w[i] = loadBE(blocks + i * 4);
+    }
+    for (int i = 16; i < 80; i++) {
+      w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    std::uint32_t a = state[0];
+    std::uint32_t b = state[1];
+    std::uint32_t c = state[2];
+    std::uint32_t d = state[3];
+    std::uint32_t e = state[4];
+
+    // five steps at a time with the variables renamed instead of shifted
+    // along, and one loop per round function so that nothing branches
+#define SHA1_STEP(a, b, c, d, e, f, k, i)          \
+  do {                                             \
+    e += rotl(a, 5) + (f) + (k) + w[i];            \
+    b = rotl(b, 30);                               \
+  } while (0)
+#define SHA1_STEPS(f, k, i)                                  \
+  do {                                                       \
+    SHA1_STEP(a, b, c, d, e, f(b, c, d), k, i);              \
+    SHA1_STEP(e, a, b, c, d, f(a, b, c), k, i + 1);          \
+    SHA1_STEP(d, e, a, b, c, f(e, a, b), k, i + 2);          \
+    SHA1_STEP(c, d, e, a, b, f(d, e, a), k, i + 3);          \
+    SHA1_STEP(b, c, d, e, a, f(c, d, e), k, i + 4);          \
+  } while (0)
+#define SHA1_CH(x, y, z) (((y) ^ (z)) & (x)) ^ (z)
+#define SHA1_PARITY(x, y, z) (x) ^ (y) ^ (z)
+#define SHA1_MAJ(x, y, z) (((x) & (y)) | (((x) | (y)) & (z)))
+
+    for (int i = 0; i < 20; i += 5) {
+      SHA1_STEPS(SHA1_CH, 0x5a827999, i);
+    }
+    for (int i = 20; i < 40; i += 5) {
+      SHA1_STEPS(SHA1_PARITY, 0x6ed9eba1, i);
+    }
+    for (int i = 40; i < 60; i += 5) {
+      SHA1_STEPS(SHA1_MAJ, 0x8f1bbcdc, i);
+    }
+    for (int i = 60; i < 80; i += 5) {
+      SHA1_STEPS(SHA1_PARITY, 0xca62c1d6, i);
+    }
+#undef SHA1_MAJ
+#undef SHA1_PARITY
+#undef SHA1_CH
+#undef SHA1_STEPS
+#undef SHA1_STEP
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+  }
+}
+
+void sha1::final(std::uint8_t *out) {
+  finish();
+  for (int i = 0; i < 5; i++) {
+    storeBE(out + i * 4, state[i]);
+  }
+}
+
+sha256::sha256() {
+  state[0] = 0x6a09e667;
+  state[1] = 0xbb67ae85;
+  state[2] = 0x3c6ef372;
+  state[3] = 0xa54ff53a;
+  state[4] = 0x510e527f;
+  state[5] = 0x9b05688c;
+  state[6] = 0x1f83d9ab;
+  state[7] = 0x5be0cd19;
+}
+
+void sha256::compress(const std::uint8_t *blocks, std::size_t count) {
+  std::uint32_t w[64];
+
+  for (; count != 0; count--, blocks += 64) {
+    for (int i = 0; i < 16; i++) {
+      w[i] = loadBE(blocks + i * 4);
+    }
+    for (int i = 16; i < 64; i++) {
+      std::uint32_t s0 =
+          rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+      std::uint32_t s1 =
+          rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+      w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    std::uint32_t a = state[0];
+    std::uint32_t b = state[1];
+    std::uint32_t c = state[2];
+    std::uint32_t d = state[3];
+    std::uint32_t e = state[4];
+    std::uint32_t f = state[5];
+    std::uint32_t g = state[6];
+    std::uint32_t h = state[7];
+
+    // eight steps at a time with the variables renamed instead of shifted
+    // along, so each step only writes d and h
+#define SHA256_STEP(a, b, c, d, e, f, g, h, i)                     \
+  do {                                                             \
+    h += (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + (((f ^ g) & e) ^ g) + \
+         sha256K[i] + w[i];                                        \
+    d += h;                                                        \
+    h += (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) +                \
+         ((a & b) | ((a | b) & c));                                \
+  } while (0)
+
+    for (int i = 0; i < 64; i += 8) {
+      SHA256_STEP(a, b, c, d, e, f, g, h, i);
+      SHA256_STEP(h, a, b, c, d, e, f, g, i + 1);
+      SHA256_STEP(g, h, a, b, c, d, e, f, i + 2);
+      SHA256_STEP(f, g, h, a, b, c, d, e, i + 3);
+      SHA256_STEP(e, f, g, h, a, b, c, d, i + 4);
+      SHA256_STEP(d, e, f, g, h, a, b, c, i + 5);
+      SHA256_STEP(c, d, e, f, g, h, a, b, i + 6);
+      SHA256_STEP(b, c, d, e, f, g, h, a, i + 7);
+    }
+#undef SHA256_STEP
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+  }
+}
+
+void sha256::final(std::uint8_t *out) {
+  finish();
+  for (int i = 0; i < 8; i++) {
+    storeBE(out + i * 4, state[i]);
+  }
+}
+} // namespace peparse
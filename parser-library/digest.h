@@ -0,0 +1,83 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013 Andrew Ruef
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#ifndef _DIGEST_H
+#define _DIGEST_H
+#include <cstddef>
+#include <cstdint>
+
+namespace peparse {
+
+/*
+ * The message digests Authenticode signs with. Input is taken as it comes
+ * and whole 64 byte blocks are compressed straight from the caller's
+ * memory, so only a partial block at either end of an update is copied.
+ */
+template <class H>
+class block_digest {
+public:
+  void update(const std::uint8_t *data, std::size_t len);
+
+protected:
+  block_digest() : total(0), used(0) {
+  }
+
+  // pad the message out with its bit length, the same for SHA-1 and SHA-256
+  void finish();
+
+  std::uint64_t total;
+  std::size_t used;
+  std::uint8_t buf[64];
+};
+
+class sha1 : public block_digest<sha1> {
+public:
+  static const std::size_t digest_size = 20;
+
+  sha1();
+  void final(std::uint8_t *out);
+
+private:
+  friend class block_digest<sha1>;
+  void compress(const std::uint8_t *blocks, std::size_t count);
+
+  std::uint32_t state[5];
+};
+
+class sha256 : public block_digest<sha256> {
+public:
+  static const std::size_t digest_size = 32;
+
+  sha256();
+  void final(std::uint8_t *out);
+
+private:
+  friend class block_digest<sha256>;
+  void compress(const std::uint8_t *blocks, std::size_t count);
+
+  std::uint32_t state[8];
+};
+} // namespace peparse
+
+#endif
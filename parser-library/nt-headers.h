@@ -137,6 +137,58 @@ constexpr std::uint32_t IMAGE_SCN_MEM_EXECUTE = 0x20000000;
 constexpr std::uint32_t IMAGE_SCN_MEM_READ = 0x40000000;
 constexpr std::uint32_t IMAGE_SCN_MEM_WRITE = 0x80000000;
 
+// Debug directory entry types
+constexpr std::uint32_t IMAGE_DEBUG_TYPE_UNKNOWN = 0;
+constexpr std::uint32_t IMAGE_DEBUG_TYPE_COFF = 1;
+constexpr std::uint32_t IMAGE_DEBUG_TYPE_CODEVIEW = 2;
+constexpr std::uint32_t IMAGE_DEBUG_TYPE_FPO = 3;
+constexpr std::uint32_t IMAGE_DEBUG_TYPE_MISC = 4;
+constexpr std::uint32_t IMAGE_DEBUG_TYPE_EXCEPTION = 5;
+constexpr std::uint32_t IMAGE_DEBUG_TYPE_FIXUP = 6;
+constexpr std::uint32_t IMAGE_DEBUG_TYPE_OMAP_TO_SRC = 7;
+constexpr std::uint32_t IMAGE_DEBUG_TYPE_OMAP_FROM_SRC = 8;
+constexpr std::uint32_t IMAGE_DEBUG_TYPE_BORLAND = 9;
+constexpr std::uint32_t IMAGE_DEBUG_TYPE_CLSID = 11;
+constexpr std::uint32_t IMAGE_DEBUG_TYPE_VC_FEATURE = 12;
+constexpr std::uint32_t IMAGE_DEBUG_TYPE_POGO = 13;
+constexpr std::uint32_t IMAGE_DEBUG_TYPE_ILTCG = 14;
+constexpr std::uint32_t IMAGE_DEBUG_TYPE_REPRO = 16;
+constexpr std::uint32_t IMAGE_DEBUG_TYPE_EX_DLLCHARACTERISTICS = 20;
+
+// Attribute certificate revisions and types
+constexpr std::uint16_t WIN_CERT_REVISION_1_0 = 0x0100;
+constexpr std::uint16_t WIN_CERT_REVISION_2_0 = 0x0200;
+constexpr std::uint16_t WIN_CERT_TYPE_X509 = 0x0001;
+constexpr std::uint16_t WIN_CERT_TYPE_PKCS_SIGNED_DATA = 0x0002;
+constexpr std::uint16_t WIN_CERT_TYPE_TS_STACK_SIGNED = 0x0004;
+
+// Control flow guard flags
+constexpr std::uint32_t IMAGE_GUARD_CF_INSTRUMENTED = 0x00000100;
+constexpr std::uint32_t IMAGE_GUARD_CFW_INSTRUMENTED = 0x00000200;
+constexpr std::uint32_t IMAGE_GUARD_CF_FUNCTION_TABLE_PRESENT = 0x00000400;
+constexpr std::uint32_t IMAGE_GUARD_SECURITY_COOKIE_UNUSED = 0x00000800;
+constexpr std::uint32_t IMAGE_GUARD_CF_LONGJUMP_TABLE_PRESENT = 0x00010000;
+constexpr std::uint32_t IMAGE_GUARD_EH_CONTINUATION_TABLE_PRESENT = 0x00400000;
+constexpr std::uint32_t IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_MASK = 0xF0000000;
+constexpr std::uint32_t IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_SHIFT = 28;
+
+// CodeView record signatures
+constexpr std::uint32_t CV_SIGNATURE_NB10 = 0x3031424E; // "NB10"
+constexpr std::uint32_t CV_SIGNATURE_RSDS = 0x53445352; // "RSDS"
+
+// CLR header flags
+constexpr std::uint32_t COMIMAGE_FLAGS_ILONLY = 0x00000001;
+constexpr std::uint32_t COMIMAGE_FLAGS_32BITREQUIRED = 0x00000002;
+constexpr std::uint32_t COMIMAGE_FLAGS_STRONGNAMESIGNED = 0x00000008;
+constexpr std::uint32_t COMIMAGE_FLAGS_NATIVE_ENTRYPOINT = 0x00000010;
+constexpr std::uint32_t COMIMAGE_FLAGS_32BITPREFERRED = 0x00020000;
+
+constexpr std::uint32_t CLR_METADATA_SIGNATURE = 0x424A5342; // "BSJB"
+
+// Rich header markers
+constexpr std::uint32_t RICH_SIGNATURE = 0x68636952;      // "Rich"
+constexpr std::uint32_t RICH_DANS_SIGNATURE = 0x536E6144; // "DanS"
+
 // Symbol section number values
 constexpr std::int16_t IMAGE_SYM_UNDEFINED = 0;
 constexpr std::int16_t IMAGE_SYM_ABSOLUTE = -1;
@@ -374,6 +426,197 @@ struct import_dir_entry {
   std::uint32_t AddressRVA;
 };
 
+struct delay_import_dir_entry {
+  std::uint32_t Attributes;
+  std::uint32_t NameRVA;
+  std::uint32_t ModuleHandleRVA;
+  std::uint32_t DelayImportAddressTableRVA;
+  std::uint32_t DelayImportNameTableRVA;
+  std::uint32_t BoundDelayImportTableRVA;
+  std::uint32_t UnloadDelayImportTableRVA;
+  std::uint32_t TimeDateStamp;
+};
+
+struct debug_dir_entry {
+  std::uint32_t Characteristics;
+  std::uint32_t TimeDateStamp;
+  std::uint16_t MajorVersion;
+  std::uint16_t MinorVersion;
+  std::uint32_t Type;
+  std::uint32_t SizeOfData;
+  std::uint32_t AddressOfRawData;
+  std::uint32_t PointerToRawData;
+};
+
+struct guid {
+  std::uint32_t Data1;
+  std::uint16_t Data2;
+  std::uint16_t Data3;
+  std::uint8_t Data4[8];
+};
+
+struct tls_dir_32 {
+  std::uint32_t StartAddressOfRawData;
+  std::uint32_t EndAddressOfRawData;
+  std::uint32_t AddressOfIndex;
+  std::uint32_t AddressOfCallBacks;
+  std::uint32_t SizeOfZeroFill;
+  std::uint32_t Characteristics;
+};
+
+struct tls_dir_64 {
+  std::uint64_t StartAddressOfRawData;
+  std::uint64_t EndAddressOfRawData;
+  std::uint64_t AddressOfIndex;
+  std::uint64_t AddressOfCallBacks;
+  std::uint32_t SizeOfZeroFill;
+  std::uint32_t Characteristics;
+};
+
+// the CLR header of a .NET image, IMAGE_COR20_HEADER
+struct clr_header {
+  std::uint32_t cb;
+  std::uint16_t MajorRuntimeVersion;
+  std::uint16_t MinorRuntimeVersion;
+  data_directory MetaData;
+  std::uint32_t Flags;
+  std::uint32_t EntryPointToken;
+  data_directory Resources;
+  data_directory StrongNameSignature;
+  data_directory CodeManagerTable;
+  data_directory VTableFixups;
+  data_directory ExportAddressTableJumps;
+  data_directory ManagedNativeHeader;
+};
+
+struct load_config_code_integrity {
+  std::uint16_t Flags;
+  std::uint16_t Catalog;
+  std::uint32_t CatalogOffset;
+  std::uint32_t Reserved;
+};
+
+/*
+ * The load config directory grew with each release and says how much of it
+ * there is in its Size field, so only the first Size bytes of these are
+ * present in an image.
+ */
+struct load_config_32 {
+  std::uint32_t Size;
+  std::uint32_t TimeDateStamp;
+  std::uint16_t MajorVersion;
+  std::uint16_t MinorVersion;
+  std::uint32_t GlobalFlagsClear;
+  std::uint32_t GlobalFlagsSet;
+  std::uint32_t CriticalSectionDefaultTimeout;
+  std::uint32_t DeCommitFreeBlockThreshold;
+  std::uint32_t DeCommitTotalFreeThreshold;
+  std::uint32_t LockPrefixTable;
+  std::uint32_t MaximumAllocationSize;
+  std::uint32_t VirtualMemoryThreshold;
+  std::uint32_t ProcessHeapFlags;
+  std::uint32_t ProcessAffinityMask;
+  std::uint16_t CSDVersion;
+  std::uint16_t DependentLoadFlags;
+  std::uint32_t EditList;
+  std::uint32_t SecurityCookie;
+  std::uint32_t SEHandlerTable;
+  std::uint32_t SEHandlerCount;
+  std::uint32_t GuardCFCheckFunctionPointer;
+  std::uint32_t GuardCFDispatchFunctionPointer;
+  std::uint32_t GuardCFFunctionTable;
+  std::uint32_t GuardCFFunctionCount;
+  std::uint32_t GuardFlags;
+  load_config_code_integrity CodeIntegrity;
+  std::uint32_t GuardAddressTakenIatEntryTable;
+  std::uint32_t GuardAddressTakenIatEntryCount;
+  std::uint32_t GuardLongJumpTargetTable;
+  std::uint32_t GuardLongJumpTargetCount;
+  std::uint32_t DynamicValueRelocTable;
+  std::uint32_t CHPEMetadataPointer;
+  std::uint32_t GuardRFFailureRoutine;
+  std::uint32_t GuardRFFailureRoutineFunctionPointer;
+  std::uint32_t DynamicValueRelocTableOffset;
+  std::uint16_t DynamicValueRelocTableSection;
+  std::uint16_t Reserved2;
+  std::uint32_t GuardRFVerifyStackPointerFunctionPointer;
+  std::uint32_t HotPatchTableOffset;
+  std::uint32_t Reserved3;
+  std::uint32_t EnclaveConfigurationPointer;
+  std::uint32_t VolatileMetadataPointer;
+  std::uint32_t GuardEHContinuationTable;
+  std::uint32_t GuardEHContinuationCount;
+  std::uint32_t GuardXFGCheckFunctionPointer;
+  std::uint32_t GuardXFGDispatchFunctionPointer;
+  std::uint32_t GuardXFGTableDispatchFunctionPointer;
+  std::uint32_t CastGuardOsDeterminedFailureMode;
+  std::uint32_t GuardMemcpyFunctionPointer;
+};
+
+struct load_config_64 {
+  std::uint32_t Size;
+  std::uint32_t TimeDateStamp;
+  std::uint16_t MajorVersion;
+  std::uint16_t MinorVersion;
+  std::uint32_t GlobalFlagsClear;
+  std::uint32_t GlobalFlagsSet;
+  std::uint32_t CriticalSectionDefaultTimeout;
+  std::uint64_t DeCommitFreeBlockThreshold;
+  std::uint64_t DeCommitTotalFreeThreshold;
+  std::uint64_t LockPrefixTable;
+  std::uint64_t MaximumAllocationSize;
+  std::uint64_t VirtualMemoryThreshold;
+  std::uint64_t ProcessAffinityMask;
+  std::uint32_t ProcessHeapFlags;
+  std::uint16_t CSDVersion;
+  std::uint16_t DependentLoadFlags;
+  std::uint64_t EditList;
+  std::uint64_t SecurityCookie;
+  std::uint64_t SEHandlerTable;
+  std::uint64_t SEHandlerCount;
+  std::uint64_t GuardCFCheckFunctionPointer;
+  std::uint64_t GuardCFDispatchFunctionPointer;
+  std::uint64_t GuardCFFunctionTable;
+  std::uint64_t GuardCFFunctionCount;
+  std::uint32_t GuardFlags;
+  load_config_code_integrity CodeIntegrity;
+  std::uint64_t GuardAddressTakenIatEntryTable;
+  std::uint64_t GuardAddressTakenIatEntryCount;
+  std::uint64_t GuardLongJumpTargetTable;
+  std::uint64_t GuardLongJumpTargetCount;
+  std::uint64_t DynamicValueRelocTable;
+  std::uint64_t CHPEMetadataPointer;
+  std::uint64_t GuardRFFailureRoutine;
+  std::uint64_t GuardRFFailureRoutineFunctionPointer;
+  std::uint32_t DynamicValueRelocTableOffset;
+  std::uint16_t DynamicValueRelocTableSection;
+  std::uint16_t Reserved2;
+  std::uint64_t GuardRFVerifyStackPointerFunctionPointer;
+  std::uint32_t HotPatchTableOffset;
+  std::uint32_t Reserved3;
+  std::uint64_t EnclaveConfigurationPointer;
+  std::uint64_t VolatileMetadataPointer;
+  std::uint64_t GuardEHContinuationTable;
+  std::uint64_t GuardEHContinuationCount;
+  std::uint64_t GuardXFGCheckFunctionPointer;
+  std::uint64_t GuardXFGDispatchFunctionPointer;
+  std::uint64_t GuardXFGTableDispatchFunctionPointer;
+  std::uint64_t CastGuardOsDeterminedFailureMode;
+  std::uint64_t GuardMemcpyFunctionPointer;
+};
+
+struct runtime_function {
+  std::uint32_t BeginAddress;
+  std::uint32_t EndAddress;
+  std::uint32_t UnwindInfoAddress;
+};
+
+struct bound_import_descriptor {
+  std::uint32_t TimeDateStamp;
+  std::uint16_t OffsetModuleName;
+  std::uint16_t NumberOfModuleForwarderRefs;
+};
+
 struct export_dir_table {
   std::uint32_t ExportFlags;
   std::uint32_t TimeDateStamp;
@@ -23,107 +23,133 @@ THE SOFTWARE.
 */
 
 #include "parse.h"
+#include "arena.h"
+#include "digest.h"
 #include "nt-headers.h"
 #include "to_string.h"
 #include <algorithm>
-#include <list>
+#include <cstdio>
+#include <mutex>
 #include <stdexcept>
 #include <string.h>
+#include <vector>
 
-using namespace std;
-
-namespace peparse {
-
-struct section {
-  string sectionName;
-  ::uint64_t sectionBase;
-  bounded_buffer *sectionData;
-  image_section_header sec;
-};
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PEPARSE_SSE2
+#include <emmintrin.h>
+#endif
 
-struct importent {
-  VA addr;
-  string symbolName;
-  string moduleName;
-};
+#if defined(_MSC_VER) && (defined(__AVX2__) || defined(PEPARSE_SSE2))
+#include <intrin.h>
+#endif
 
-struct exportent {
-  VA addr;
-  string symbolName;
-  string moduleName;
-};
+using namespace std;
 
-struct reloc {
-  VA shiftedAddr;
-  reloc_type type;
-};
+namespace peparse {
 
 #define SYMBOL_NAME_OFFSET(sn) ((uint32_t)(sn.data >> 32))
 #define SYMBOL_TYPE_HI(x) (x.type >> 8)
 
-union symbol_name {
-  uint8_t shortName[NT_SHORT_NAME_LEN];
-  uint32_t zeroes;
-  uint64_t data;
-};
-
-struct aux_symbol_f1 {
-  uint32_t tagIndex;
-  uint32_t totalSize;
-  uint32_t pointerToLineNumber;
-  uint32_t pointerToNextFunction;
-};
-
-struct aux_symbol_f2 {
-  uint16_t lineNumber;
-  uint32_t pointerToNextFunction;
-};
-
-struct aux_symbol_f3 {
-  uint32_t tagIndex;
-  uint32_t characteristics;
-};
-
-struct aux_symbol_f4 {
-  uint8_t filename[SYMTAB_RECORD_LEN];
-  string strFilename;
-};
-
-struct aux_symbol_f5 {
-  uint32_t length;
-  uint16_t numberOfRelocations;
-  uint16_t numberOfLineNumbers;
-  uint32_t checkSum;
-  uint16_t number;
-  uint8_t selection;
-};
-
-struct symbol {
-  string strName;
-  symbol_name name;
-  uint32_t value;
-  int16_t sectionNumber;
-  uint16_t type;
-  uint8_t storageClass;
-  uint8_t numberOfAuxSymbols;
-  list<aux_symbol_f1> aux_symbols_f1;
-  list<aux_symbol_f2> aux_symbols_f2;
-  list<aux_symbol_f3> aux_symbols_f3;
-  list<aux_symbol_f4> aux_symbols_f4;
-  list<aux_symbol_f5> aux_symbols_f5;
+/*
+ * One entry of the section lookup index. The index is sorted by low and
+ * every entry remembers the highest end address of itself and all of the
+ * entries before it, so a lookup can stop walking backwards as soon as no
+ * earlier section can reach the address any more.
+ */
+struct section_interval {
+  ::uint64_t low;
+  ::uint64_t high;
+  ::uint64_t maxHigh;
+  ::uint32_t order;
+  const section *sec;
 };
 
 struct parsed_pe_internal {
-  list<section> secs;
-  list<resource> rsrcs;
-  list<importent> imports;
-  list<reloc> relocs;
-  list<exportent> exports;
-  list<symbol> symbols;
+  parsed_pe_internal()
+      : secs(arena_allocator<section>(&mem)),
+        secIndex(arena_allocator<section_interval>(&mem)),
+        rsrcs(arena_allocator<resource>(&mem)),
+        imports(arena_allocator<importent>(&mem)),
+        delayImports(arena_allocator<importent>(&mem)),
+        boundImports(arena_allocator<boundimportent>(&mem)),
+        iat(arena_allocator<iatent>(&mem)),
+        functionCopy(arena_allocator<runtime_function>(&mem)),
+        debugEntries(arena_allocator<debug_dir_entry>(&mem)),
+        hasTLS(false),
+        tlsCallbacks(arena_allocator<VA>(&mem)),
+        hasLoadConfig(false),
+        certificates(arena_allocator<certificate>(&mem)),
+        hasCLR(false),
+        hasCLRMetadata(false),
+        clrStreams(arena_allocator<clr_stream>(&mem)),
+        relocs(arena_allocator<reloc>(&mem)),
+        exports(arena_allocator<exportent>(&mem)),
+        symbols(arena_allocator<symbol>(&mem)),
+        expByName(arena_allocator<::uint32_t>(&mem)),
+        expByOrdinal(arena_allocator<::uint32_t>(&mem)),
+        expOrdinalBase(0),
+        flags(0),
+        parsed(0) {
+  }
+
+  // everything below is allocated from mem, so it has to be declared first
+  // to be destroyed last
+  arena mem;
+  arena_vector<section> secs;
+  arena_vector<section_interval> secIndex;
+  arena_vector<resource> rsrcs;
+  arena_vector<importent> imports;
+  arena_vector<importent> delayImports;
+  arena_vector<boundimportent> boundImports;
+  arena_vector<iatent> iat;
+
+  // the exception directory's function table. It is read in place when
+  // that's possible, and otherwise functionCopy holds it
+  pe_view<runtime_function> functions;
+  arena_vector<runtime_function> functionCopy;
+
+  arena_vector<debug_dir_entry> debugEntries;
+
+  tls_directory tls;
+  bool hasTLS;
+  arena_vector<VA> tlsCallbacks;
+
+  // the load config directory, widened to the PE32+ layout and zeroed past
+  // the Size the image gives
+  load_config_64 loadConfig;
+  bool hasLoadConfig;
+  arena_vector<certificate> certificates;
+
+  // the CLR header, and the metadata root and stream headers it points at
+  clr_header clr;
+  bool hasCLR;
+  clr_metadata clrMetadata;
+  bool hasCLRMetadata;
+  arena_vector<clr_stream> clrStreams;
+
+  arena_vector<reloc> relocs;
+  arena_vector<exportent> exports;
+  arena_vector<symbol> symbols;
+
+  // export lookup tables, built once by the parse or the first FindExport
+  // call, whichever needs them first. Both hold an
+  // index into exports plus one, so 0 is an empty slot. expByName is open
+  // addressed on the name hash, expByOrdinal is indexed by EAT slot, the
+  // ordinal less the export directory's OrdinalBase
+  arena_vector<::uint32_t> expByName;
+  arena_vector<::uint32_t> expByOrdinal;
+  ::uint32_t expOrdinalBase;
+  std::once_flag expIndexed;
+
+  // the pe_parse_flags of the parse, and the directories already read
+  ::uint32_t flags;
+  ::uint32_t parsed;
 };
 
-::uint32_t err = 0;
-std::string err_loc;
+static thread_local pe_error lastErr = {PEERR_NONE, nullptr, 0};
 
 static const char *pe_err_str[] = {"None",
                                    "Out of memory",
@@ -134,53 +160,755 @@ static const char *pe_err_str[] = {"None",
                                    "Unable to read data",
                                    "Unable to open",
                                    "Unable to stat",
-                                   "Bad magic"};
+                                   "Bad magic",
+                                   "Batch callback threw an exception"};
+
+void setPEErr(pe_err code, const char *func, ::uint32_t line) {
+  lastErr.code = code;
+  lastErr.func = func;
+  lastErr.line = line;
+}
+
+static void clearPEErr() {
+  setPEErr(PEERR_NONE, nullptr, 0);
+}
 
 int GetPEErr() {
-  return err;
+  return lastErr.code;
 }
 
 string GetPEErrString() {
-  return pe_err_str[err];
+  return GetPEErrDescription(lastErr.code);
 }
 
 string GetPEErrLoc() {
-  return err_loc;
+  if (lastErr.func == nullptr) {
+    return string();
+  }
+
+  return lastErr.func + (":" + to_string<::uint32_t>(lastErr.line, dec));
 }
 
-static bool
-readCString(const bounded_buffer &buffer, ::uint32_t off, string &result) {
-  if (off < buffer.bufLen) {
-    ::uint8_t *p = buffer.buf;
-    ::uint32_t n = buffer.bufLen;
-    ::uint8_t *b = p + off;
-    ::uint8_t *x = std::find(b, p + n, 0);
-    if (x == p + n) {
-      return false;
+pe_error GetPEErrInfo() {
+  return lastErr;
+}
+
+const char *GetPEErrDescription(pe_err code) {
+  int c = code;
+  if (c < 0 || static_cast<std::size_t>(c) >=
+                   sizeof(pe_err_str) / sizeof(pe_err_str[0])) {
+    return "Unknown error";
+  }
+
+  return pe_err_str[code];
+}
+
+// number of bytes that can be read from b starting at off, used to bound
+// reservations so it saturates at 4 GiB
+static ::uint32_t bytesAvailable(bounded_buffer *b, ::uint64_t off) {
+  if (b == nullptr || off >= b->bufLen) {
+    return 0;
+  }
+
+  ::uint64_t n = b->bufLen - off;
+  return n > UINT32_MAX ? UINT32_MAX : static_cast<::uint32_t>(n);
+}
+
+#if defined(__AVX2__) || defined(PEPARSE_SSE2)
+// index of the lowest set bit of a non zero mask
+static inline ::uint32_t lowestBit(::uint32_t m) {
+#ifdef _MSC_VER
+  unsigned long i;
+  _BitScanForward(&i, m);
+  return i;
+#else
+  return __builtin_ctz(m);
+#endif
+}
+#endif
+
+/*
+ * Find the NUL at or after p, or e when there is none before it. Names are
+ * mostly short, so a whole vector of bytes is compared at once and the
+ * loads never reach past e.
+ */
+static const ::uint8_t *findNul(const ::uint8_t *p, const ::uint8_t *e) {
+#if defined(__AVX2__)
+  const __m256i zero32 = _mm256_setzero_si256();
+  while (e - p >= 32) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+    ::uint32_t m = static_cast<::uint32_t>(
+        _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero32)));
+    if (m != 0) {
+      return p + lowestBit(m);
+    }
+    p += 32;
+  }
+#endif
+
+#if defined(__AVX2__) || defined(PEPARSE_SSE2)
+  const __m128i zero16 = _mm_setzero_si128();
+  while (e - p >= 16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+    ::uint32_t m = static_cast<::uint32_t>(
+        _mm_movemask_epi8(_mm_cmpeq_epi8(v, zero16)));
+    if (m != 0) {
+      return p + lowestBit(m);
     }
-    result.insert(result.end(), b, x);
+    p += 16;
+  }
+#endif
+
+  while (p != e && *p != 0) {
+    p++;
+  }
+
+  return p;
+}
+
+/*
+ * Add up len bytes as little endian 16 bit words, with an odd byte at the
+ * end counting as a word of its own. The vector loops add the even and odd
+ * words of each 32 bit lane into lanes of 32 bits, which can't overflow in
+ * 0x8000 rounds, and widen those into 64 bit totals after every run.
+ */
+static ::uint64_t sumWords(const ::uint8_t *p, ::uint64_t len) {
+  const ::uint8_t *e = p + len;
+  ::uint64_t sum = 0;
+
+#if defined(__AVX2__)
+  const __m256i lowWords32 = _mm256_set1_epi32(0xFFFF);
+  __m256i total32 = _mm256_setzero_si256();
+  while (e - p >= 32) {
+    std::size_t rounds = std::min<std::size_t>((e - p) / 32, 0x8000);
+    __m256i acc = _mm256_setzero_si256();
+    for (std::size_t i = 0; i < rounds; i++, p += 32) {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+      acc = _mm256_add_epi32(acc, _mm256_and_si256(v, lowWords32));
+      acc = _mm256_add_epi32(acc, _mm256_srli_epi32(v, 16));
+    }
+    total32 = _mm256_add_epi64(
+        total32, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(acc)));
+    total32 = _mm256_add_epi64(
+        total32, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(acc, 1)));
+  }
+
+  ::uint64_t lanes32[4];
+  _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes32), total32);
+  sum += lanes32[0] + lanes32[1] + lanes32[2] + lanes32[3];
+#endif
+
+#if defined(__AVX2__) || defined(PEPARSE_SSE2)
+  const __m128i lowWords16 = _mm_set1_epi32(0xFFFF);
+  const __m128i zero16 = _mm_setzero_si128();
+  __m128i total16 = _mm_setzero_si128();
+  while (e - p >= 16) {
+    std::size_t rounds = std::min<std::size_t>((e - p) / 16, 0x8000);
+    __m128i acc = _mm_setzero_si128();
+    for (std::size_t i = 0; i < rounds; i++, p += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+      acc = _mm_add_epi32(acc, _mm_and_si128(v, lowWords16));
+      acc = _mm_add_epi32(acc, _mm_srli_epi32(v, 16));
+    }
+    total16 = _mm_add_epi64(total16, _mm_unpacklo_epi32(acc, zero16));
+    total16 = _mm_add_epi64(total16, _mm_unpackhi_epi32(acc, zero16));
+  }
+
+  ::uint64_t lanes16[2];
+  _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes16), total16);
+  sum += lanes16[0] + lanes16[1];
+#endif
+
+  for (; e - p >= 2; p += 2) {
+    sum += p[0] | (static_cast<::uint32_t>(p[1]) << 8);
+  }
+
+  if (p != e) {
+    sum += *p;
+  }
+
+  return sum;
+}
+
+/*
+ * Get the NUL terminated string at off. The result points into buffer, so
+ * nothing is copied, except for module names, which are compared upper
+ * case and so get folded into a copy in the arena.
+ */
+static bool readCString(arena &mem,
+                        bounded_buffer *buffer,
+                        ::uint64_t off,
+                        pe_string_view &result,
+                        bool upper = false) {
+  if (buffer == nullptr || off >= buffer->bufLen) {
+    return false;
+  }
+
+  const ::uint8_t *b = buffer->buf + off;
+  const ::uint8_t *e = buffer->buf + buffer->bufLen;
+  const ::uint8_t *x = findNul(b, e);
+  if (x == e) {
+    return false;
+  }
+
+  if (!upper) {
+    result = pe_string_view(reinterpret_cast<const char *>(b), x - b);
     return true;
   }
-  return false;
+
+  char *dst = mem.copy(b, x - b);
+  if (dst == nullptr) {
+    return false;
+  }
+
+  std::transform(dst, dst + (x - b), dst, ::toupper);
+
+  result = pe_string_view(dst, x - b);
+  return true;
 }
 
-bool getSecForVA(list<section> &secs, VA v, section &sec) {
-  for (section s : secs) {
-    ::uint64_t low = s.sectionBase;
-    ::uint64_t high = low + s.sec.Misc.VirtualSize;
+// get the len bytes at off as a string, without copying them
+static bool readFixedString(bounded_buffer *buffer,
+                            ::uint64_t off,
+                            ::uint32_t len,
+                            pe_string_view &result) {
+  if (buffer == nullptr || off > buffer->bufLen ||
+      len > buffer->bufLen - off) {
+    return false;
+  }
 
-    if (v >= low && v < high) {
-      sec = s;
-      return true;
+  result = pe_string_view(reinterpret_cast<const char *>(buffer->buf + off),
+                          len);
+  return true;
+}
+
+// build the ORDINAL_<module>_<n> name used for imports by ordinal
+static bool makeOrdinalName(arena &mem,
+                            const pe_string_view &modName,
+                            ::uint16_t ordinal,
+                            pe_string_view &result) {
+  static const char prefix[] = "ORDINAL_";
+  const ::uint32_t prefixLen = sizeof(prefix) - 1;
+
+  char num[8];
+  int numLen = snprintf(num, sizeof(num), "%u", ordinal);
+  if (numLen <= 0) {
+    return false;
+  }
+
+  std::size_t len = prefixLen + modName.size() + 1 + numLen;
+  char *dst = static_cast<char *>(mem.allocate(len, 1));
+  if (dst == nullptr) {
+    return false;
+  }
+
+  memcpy(dst, prefix, prefixLen);
+  memcpy(dst + prefixLen, modName.data(), modName.size());
+  dst[prefixLen + modName.size()] = '_';
+  memcpy(dst + prefixLen + modName.size() + 1, num, numLen);
+
+  result = pe_string_view(dst, len);
+  return true;
+}
+
+// room for count auxiliary symbol records, which go away with the arena
+template <class T>
+static T *allocAuxRecords(arena &mem, ::uint8_t count) {
+  return static_cast<T *>(mem.allocate(count * sizeof(T), alignof(T)));
+}
+
+/*
+ * Split a buffer whose bookkeeping lives in the parse arena. It goes away
+ * with the arena and must not be handed to deleteBuffer.
+ */
+static bounded_buffer *splitBufferInArena(arena &mem,
+                                          bounded_buffer *b,
+                                          ::uint64_t from,
+                                          ::uint64_t to) {
+  if (b == nullptr) {
+    return nullptr;
+  }
+
+  // safety checks
+  if (to < from || to > b->bufLen) {
+    return nullptr;
+  }
+
+  void *p = mem.allocate(sizeof(bounded_buffer), alignof(bounded_buffer));
+
+  if (p == nullptr) {
+    return nullptr;
+  }
+
+  bounded_buffer *newBuff = new (p) bounded_buffer();
+
+  newBuff->copy = true;
+  newBuff->buf = b->buf + from;
+  newBuff->bufLen = (to - from);
+
+  return newBuff;
+}
+
+/*
+ * Field layouts of the on-disk structs that are decoded in one piece by
+ * readStruct. The structs in nt-headers.h are laid out like the file
+ * format, which the asserts below hold them to.
+ */
+#define FIELD(t, f) \
+  { _offset(t, f), sizeof(((t *) 0)->f), 1 }
+#define FIELD_ARRAY(t, f)                   \
+  {                                         \
+    _offset(t, f), sizeof(((t *) 0)->f[0]), \
+        sizeof(((t *) 0)->f) / sizeof(((t *) 0)->f[0]) \
+  }
+#define FIELD_END \
+  { 0, 0, 0 }
+
+static_assert(sizeof(file_header) == 20, "file_header layout");
+static_assert(sizeof(data_directory) == 8, "data_directory layout");
+static_assert(sizeof(optional_header_32) == 224, "optional_header_32 layout");
+static_assert(sizeof(optional_header_64) == 240, "optional_header_64 layout");
+static_assert(sizeof(image_section_header) == 40,
+              "image_section_header layout");
+static_assert(sizeof(export_dir_table) == 40, "export_dir_table layout");
+static_assert(sizeof(delay_import_dir_entry) == 32,
+              "delay_import_dir_entry layout");
+static_assert(sizeof(bound_import_descriptor) == 8,
+              "bound_import_descriptor layout");
+static_assert(sizeof(runtime_function) == 12, "runtime_function layout");
+static_assert(sizeof(tls_dir_32) == 24, "tls_dir_32 layout");
+static_assert(sizeof(debug_dir_entry) == 28, "debug_dir_entry layout");
+static_assert(sizeof(clr_header) == 72, "clr_header layout");
+static_assert(sizeof(load_config_32) == 192, "load_config_32 layout");
+static_assert(sizeof(load_config_64) == 320, "load_config_64 layout");
+static_assert(sizeof(tls_dir_64) == 40, "tls_dir_64 layout");
+
+template <class T>
+struct struct_fields {
+  static const field_desc fields[];
+};
+
+template <>
+const field_desc struct_fields<file_header>::fields[] = {
+    FIELD(file_header, Machine),
+    FIELD(file_header, NumberOfSections),
+    FIELD(file_header, TimeDateStamp),
+    FIELD(file_header, PointerToSymbolTable),
+    FIELD(file_header, NumberOfSymbols),
+    FIELD(file_header, SizeOfOptionalHeader),
+    FIELD(file_header, Characteristics),
+    FIELD_END};
+
+template <>
+const field_desc struct_fields<data_directory>::fields[] = {
+    FIELD(data_directory, VirtualAddress),
+    FIELD(data_directory, Size),
+    FIELD_END};
+
+template <>
+const field_desc struct_fields<optional_header_32>::fields[] = {
+    FIELD(optional_header_32, Magic),
+    FIELD(optional_header_32, SizeOfCode),
+    FIELD(optional_header_32, SizeOfInitializedData),
+    FIELD(optional_header_32, SizeOfUninitializedData),
+    FIELD(optional_header_32, AddressOfEntryPoint),
+    FIELD(optional_header_32, BaseOfCode),
+    FIELD(optional_header_32, BaseOfData),
+    FIELD(optional_header_32, ImageBase),
+    FIELD(optional_header_32, SectionAlignment),
+    FIELD(optional_header_32, FileAlignment),
+    FIELD(optional_header_32, MajorOperatingSystemVersion),
+    FIELD(optional_header_32, MinorOperatingSystemVersion),
+    FIELD(optional_header_32, MajorImageVersion),
+    FIELD(optional_header_32, MinorImageVersion),
+    FIELD(optional_header_32, MajorSubsystemVersion),
+    FIELD(optional_header_32, MinorSubsystemVersion),
+    FIELD(optional_header_32, Win32VersionValue),
+    FIELD(optional_header_32, SizeOfImage),
+    FIELD(optional_header_32, SizeOfHeaders),
+    FIELD(optional_header_32, CheckSum),
+    FIELD(optional_header_32, Subsystem),
+    FIELD(optional_header_32, DllCharacteristics),
+    FIELD(optional_header_32, SizeOfStackReserve),
+    FIELD(optional_header_32, SizeOfStackCommit),
+    FIELD(optional_header_32, SizeOfHeapReserve),
+    FIELD(optional_header_32, SizeOfHeapCommit),
+    FIELD(optional_header_32, LoaderFlags),
+    FIELD(optional_header_32, NumberOfRvaAndSizes),
+    FIELD_END};
+
+template <>
+const field_desc struct_fields<optional_header_64>::fields[] = {
+    FIELD(optional_header_64, Magic),
+    FIELD(optional_header_64, SizeOfCode),
+    FIELD(optional_header_64, SizeOfInitializedData),
+    FIELD(optional_header_64, SizeOfUninitializedData),
+    FIELD(optional_header_64, AddressOfEntryPoint),
+    FIELD(optional_header_64, BaseOfCode),
+    FIELD(optional_header_64, ImageBase),
+    FIELD(optional_header_64, SectionAlignment),
+    FIELD(optional_header_64, FileAlignment),
+    FIELD(optional_header_64, MajorOperatingSystemVersion),
+    FIELD(optional_header_64, MinorOperatingSystemVersion),
+    FIELD(optional_header_64, MajorImageVersion),
+    FIELD(optional_header_64, MinorImageVersion),
+    FIELD(optional_header_64, MajorSubsystemVersion),
+    FIELD(optional_header_64, MinorSubsystemVersion),
+    FIELD(optional_header_64, Win32VersionValue),
+    FIELD(optional_header_64, SizeOfImage),
+    FIELD(optional_header_64, SizeOfHeaders),
+    FIELD(optional_header_64, CheckSum),
+    FIELD(optional_header_64, Subsystem),
+    FIELD(optional_header_64, DllCharacteristics),
+    FIELD(optional_header_64, SizeOfStackReserve),
+    FIELD(optional_header_64, SizeOfStackCommit),
+    FIELD(optional_header_64, SizeOfHeapReserve),
+    FIELD(optional_header_64, SizeOfHeapCommit),
+    FIELD(optional_header_64, LoaderFlags),
+    FIELD(optional_header_64, NumberOfRvaAndSizes),
+    FIELD_END};
+
+template <>
+const field_desc struct_fields<image_section_header>::fields[] = {
+    FIELD(image_section_header, Misc.VirtualSize),
+    FIELD(image_section_header, VirtualAddress),
+    FIELD(image_section_header, SizeOfRawData),
+    FIELD(image_section_header, PointerToRawData),
+    FIELD(image_section_header, PointerToRelocations),
+    FIELD(image_section_header, PointerToLinenumbers),
+    FIELD(image_section_header, NumberOfRelocations),
+    FIELD(image_section_header, NumberOfLinenumbers),
+    FIELD(image_section_header, Characteristics),
+    FIELD_END};
+
+template <>
+const field_desc struct_fields<export_dir_table>::fields[] = {
+    FIELD(export_dir_table, ExportFlags),
+    FIELD(export_dir_table, TimeDateStamp),
+    FIELD(export_dir_table, MajorVersion),
+    FIELD(export_dir_table, MinorVersion),
+    FIELD(export_dir_table, NameRVA),
+    FIELD(export_dir_table, OrdinalBase),
+    FIELD(export_dir_table, AddressTableEntries),
+    FIELD(export_dir_table, NumberOfNamePointers),
+    FIELD(export_dir_table, ExportAddressTableRVA),
+    FIELD(export_dir_table, NamePointerRVA),
+    FIELD(export_dir_table, OrdinalTableRVA),
+    FIELD_END};
+
+template <>
+const field_desc struct_fields<delay_import_dir_entry>::fields[] = {
+    FIELD(delay_import_dir_entry, Attributes),
+    FIELD(delay_import_dir_entry, NameRVA),
+    FIELD(delay_import_dir_entry, ModuleHandleRVA),
+    FIELD(delay_import_dir_entry, DelayImportAddressTableRVA),
+    FIELD(delay_import_dir_entry, DelayImportNameTableRVA),
+    FIELD(delay_import_dir_entry, BoundDelayImportTableRVA),
+    FIELD(delay_import_dir_entry, UnloadDelayImportTableRVA),
+    FIELD(delay_import_dir_entry, TimeDateStamp),
+    FIELD_END};
+
+template <>
+const field_desc struct_fields<bound_import_descriptor>::fields[] = {
+    FIELD(bound_import_descriptor, TimeDateStamp),
+    FIELD(bound_import_descriptor, OffsetModuleName),
+    FIELD(bound_import_descriptor, NumberOfModuleForwarderRefs),
+    FIELD_END};
+
+template <>
+const field_desc struct_fields<runtime_function>::fields[] = {
+    FIELD(runtime_function, BeginAddress),
+    FIELD(runtime_function, EndAddress),
+    FIELD(runtime_function, UnwindInfoAddress),
+    FIELD_END};
+
+template <>
+const field_desc struct_fields<tls_dir_32>::fields[] = {
+    FIELD(tls_dir_32, StartAddressOfRawData),
+    FIELD(tls_dir_32, EndAddressOfRawData),
+    FIELD(tls_dir_32, AddressOfIndex),
+    FIELD(tls_dir_32, AddressOfCallBacks),
+    FIELD(tls_dir_32, SizeOfZeroFill),
+    FIELD(tls_dir_32, Characteristics),
+    FIELD_END};
+
+template <>
+const field_desc struct_fields<tls_dir_64>::fields[] = {
+    FIELD(tls_dir_64, StartAddressOfRawData),
+    FIELD(tls_dir_64, EndAddressOfRawData),
+    FIELD(tls_dir_64, AddressOfIndex),
+    FIELD(tls_dir_64, AddressOfCallBacks),
+    FIELD(tls_dir_64, SizeOfZeroFill),
+    FIELD(tls_dir_64, Characteristics),
+    FIELD_END};
+
+template <>
+const field_desc struct_fields<debug_dir_entry>::fields[] = {
+    FIELD(debug_dir_entry, Characteristics),
+    FIELD(debug_dir_entry, TimeDateStamp),
+    FIELD(debug_dir_entry, MajorVersion),
+    FIELD(debug_dir_entry, MinorVersion),
+    FIELD(debug_dir_entry, Type),
+    FIELD(debug_dir_entry, SizeOfData),
+    FIELD(debug_dir_entry, AddressOfRawData),
+    FIELD(debug_dir_entry, PointerToRawData),
+    FIELD_END};
+
+template <>
+const field_desc struct_fields<clr_header>::fields[] = {
+    FIELD(clr_header, cb),
+    FIELD(clr_header, MajorRuntimeVersion),
+    FIELD(clr_header, MinorRuntimeVersion),
+    FIELD(clr_header, MetaData.VirtualAddress),
+    FIELD(clr_header, MetaData.Size),
+    FIELD(clr_header, Flags),
+    FIELD(clr_header, EntryPointToken),
+    FIELD(clr_header, Resources.VirtualAddress),
+    FIELD(clr_header, Resources.Size),
+    FIELD(clr_header, StrongNameSignature.VirtualAddress),
+    FIELD(clr_header, StrongNameSignature.Size),
+    FIELD(clr_header, CodeManagerTable.VirtualAddress),
+    FIELD(clr_header, CodeManagerTable.Size),
+    FIELD(clr_header, VTableFixups.VirtualAddress),
+    FIELD(clr_header, VTableFixups.Size),
+    FIELD(clr_header, ExportAddressTableJumps.VirtualAddress),
+    FIELD(clr_header, ExportAddressTableJumps.Size),
+    FIELD(clr_header, ManagedNativeHeader.VirtualAddress),
+    FIELD(clr_header, ManagedNativeHeader.Size),
+    FIELD_END};
+
+template <>
+const field_desc struct_fields<load_config_32>::fields[] = {
+    FIELD(load_config_32, Size),
+    FIELD(load_config_32, TimeDateStamp),
+    FIELD(load_config_32, MajorVersion),
+    FIELD(load_config_32, MinorVersion),
+    FIELD(load_config_32, GlobalFlagsClear),
+    FIELD(load_config_32, GlobalFlagsSet),
+    FIELD(load_config_32, CriticalSectionDefaultTimeout),
+    FIELD(load_config_32, DeCommitFreeBlockThreshold),
+    FIELD(load_config_32, DeCommitTotalFreeThreshold),
+    FIELD(load_config_32, LockPrefixTable),
+    FIELD(load_config_32, MaximumAllocationSize),
+    FIELD(load_config_32, VirtualMemoryThreshold),
+    FIELD(load_config_32, ProcessHeapFlags),
+    FIELD(load_config_32, ProcessAffinityMask),
+    FIELD(load_config_32, CSDVersion),
+    FIELD(load_config_32, DependentLoadFlags),
+    FIELD(load_config_32, EditList),
+    FIELD(load_config_32, SecurityCookie),
+    FIELD(load_config_32, SEHandlerTable),
+    FIELD(load_config_32, SEHandlerCount),
+    FIELD(load_config_32, GuardCFCheckFunctionPointer),
+    FIELD(load_config_32, GuardCFDispatchFunctionPointer),
+    FIELD(load_config_32, GuardCFFunctionTable),
+    FIELD(load_config_32, GuardCFFunctionCount),
+    FIELD(load_config_32, GuardFlags),
+    FIELD(load_config_32, CodeIntegrity.Flags),
+    FIELD(load_config_32, CodeIntegrity.Catalog),
+    FIELD(load_config_32, CodeIntegrity.CatalogOffset),
+    FIELD(load_config_32, CodeIntegrity.Reserved),
+    FIELD(load_config_32, GuardAddressTakenIatEntryTable),
+    FIELD(load_config_32, GuardAddressTakenIatEntryCount),
+    FIELD(load_config_32, GuardLongJumpTargetTable),
+    FIELD(load_config_32, GuardLongJumpTargetCount),
+    FIELD(load_config_32, DynamicValueRelocTable),
+    FIELD(load_config_32, CHPEMetadataPointer),
+    FIELD(load_config_32, GuardRFFailureRoutine),
+    FIELD(load_config_32, GuardRFFailureRoutineFunctionPointer),
+    FIELD(load_config_32, DynamicValueRelocTableOffset),
+    FIELD(load_config_32, DynamicValueRelocTableSection),
+    FIELD(load_config_32, GuardRFVerifyStackPointerFunctionPointer),
+    FIELD(load_config_32, HotPatchTableOffset),
+    FIELD(load_config_32, EnclaveConfigurationPointer),
+    FIELD(load_config_32, VolatileMetadataPointer),
+    FIELD(load_config_32, GuardEHContinuationTable),
+    FIELD(load_config_32, GuardEHContinuationCount),
+    FIELD(load_config_32, GuardXFGCheckFunctionPointer),
+    FIELD(load_config_32, GuardXFGDispatchFunctionPointer),
+    FIELD(load_config_32, GuardXFGTableDispatchFunctionPointer),
+    FIELD(load_config_32, CastGuardOsDeterminedFailureMode),
+    FIELD(load_config_32, GuardMemcpyFunctionPointer),
+    FIELD_END};
+
+template <>
+const field_desc struct_fields<load_config_64>::fields[] = {
+    FIELD(load_config_64, Size),
+    FIELD(load_config_64, TimeDateStamp),
+    FIELD(load_config_64, MajorVersion),
+    FIELD(load_config_64, MinorVersion),
+    FIELD(load_config_64, GlobalFlagsClear),
+    FIELD(load_config_64, GlobalFlagsSet),
+    FIELD(load_config_64, CriticalSectionDefaultTimeout),
+    FIELD(load_config_64, DeCommitFreeBlockThreshold),
+    FIELD(load_config_64, DeCommitTotalFreeThreshold),
+    FIELD(load_config_64, LockPrefixTable),
+    FIELD(load_config_64, MaximumAllocationSize),
+    FIELD(load_config_64, VirtualMemoryThreshold),
+    FIELD(load_config_64, ProcessAffinityMask),
+    FIELD(load_config_64, ProcessHeapFlags),
+    FIELD(load_config_64, CSDVersion),
+    FIELD(load_config_64, DependentLoadFlags),
+    FIELD(load_config_64, EditList),
+    FIELD(load_config_64, SecurityCookie),
+    FIELD(load_config_64, SEHandlerTable),
+    FIELD(load_config_64, SEHandlerCount),
+    FIELD(load_config_64, GuardCFCheckFunctionPointer),
+    FIELD(load_config_64, GuardCFDispatchFunctionPointer),
+    FIELD(load_config_64, GuardCFFunctionTable),
+    FIELD(load_config_64, GuardCFFunctionCount),
+    FIELD(load_config_64, GuardFlags),
+    FIELD(load_config_64, CodeIntegrity.Flags),
+    FIELD(load_config_64, CodeIntegrity.Catalog),
+    FIELD(load_config_64, CodeIntegrity.CatalogOffset),
+    FIELD(load_config_64, CodeIntegrity.Reserved),
+    FIELD(load_config_64, GuardAddressTakenIatEntryTable),
+    FIELD(load_config_64, GuardAddressTakenIatEntryCount),
+    FIELD(load_config_64, GuardLongJumpTargetTable),
+    FIELD(load_config_64, GuardLongJumpTargetCount),
+    FIELD(load_config_64, DynamicValueRelocTable),
+    FIELD(load_config_64, CHPEMetadataPointer),
+    FIELD(load_config_64, GuardRFFailureRoutine),
+    FIELD(load_config_64, GuardRFFailureRoutineFunctionPointer),
+    FIELD(load_config_64, DynamicValueRelocTableOffset),
+    FIELD(load_config_64, DynamicValueRelocTableSection),
+    FIELD(load_config_64, GuardRFVerifyStackPointerFunctionPointer),
+    FIELD(load_config_64, HotPatchTableOffset),
+    FIELD(load_config_64, EnclaveConfigurationPointer),
+    FIELD(load_config_64, VolatileMetadataPointer),
+    FIELD(load_config_64, GuardEHContinuationTable),
+    FIELD(load_config_64, GuardEHContinuationCount),
+    FIELD(load_config_64, GuardXFGCheckFunctionPointer),
+    FIELD(load_config_64, GuardXFGDispatchFunctionPointer),
+    FIELD(load_config_64, GuardXFGTableDispatchFunctionPointer),
+    FIELD(load_config_64, CastGuardOsDeterminedFailureMode),
+    FIELD(load_config_64, GuardMemcpyFunctionPointer),
+    FIELD_END};
+
+// decode the first len bytes of a T at off, by default the whole struct
+template <class T>
+static bool readStruct(bounded_buffer *b,
+                       ::uint64_t off,
+                       T &out,
+                       ::uint32_t len = sizeof(T)) {
+  return readFields(b, off, &out, len, sizeof(T), struct_fields<T>::fields);
+}
+
+// decode count consecutive Ts at off
+template <class T>
+static bool
+readStructs(bounded_buffer *b, ::uint64_t off, T *out, ::uint32_t count) {
+  return readFields(b,
+                    off,
+                    out,
+                    count * static_cast<::uint32_t>(sizeof(T)),
+                    sizeof(T),
+                    struct_fields<T>::fields);
+}
+
+static bool lowerSectionStart(const section_interval &a,
+                              const section_interval &b) {
+  if (a.low != b.low) {
+    return a.low < b.low;
+  }
+
+  return a.order < b.order;
+}
+
+static bool vaBeforeSection(VA v, const section_interval &i) {
+  return v < i.low;
+}
+
+void buildSecIndex(const arena_vector<section> &secs,
+                   arena_vector<section_interval> &secIndex) {
+  secIndex.clear();
+  secIndex.reserve(secs.size());
+
+  ::uint32_t order = 0;
+  for (const section &s : secs) {
+    section_interval i;
+
+    i.low = s.sectionBase;
+    i.high = i.low + s.sec.Misc.VirtualSize;
+    i.maxHigh = 0;
+    i.order = order++;
+    i.sec = &s;
+    secIndex.push_back(i);
+  }
+
+  std::sort(secIndex.begin(), secIndex.end(), lowerSectionStart);
+
+  ::uint64_t maxHigh = 0;
+  for (section_interval &i : secIndex) {
+    maxHigh = std::max(maxHigh, i.high);
+    i.maxHigh = maxHigh;
+  }
+}
+
+/*
+ * Find the section containing v. When sections overlap, the one that comes
+ * first in the section table wins, which is what a linear walk over the
+ * section table would give.
+ */
+bool getSecForVA(const arena_vector<section_interval> &secIndex,
+                 VA v,
+                 const section *&sec) {
+  arena_vector<section_interval>::const_iterator it = std::upper_bound(
+      secIndex.begin(), secIndex.end(), v, vaBeforeSection);
+
+  const section *found = nullptr;
+  ::uint32_t foundOrder = 0;
+  while (it != secIndex.begin()) {
+    --it;
+
+    if (it->maxHigh <= v) {
+      break;
+    }
+
+    if (v < it->high && (found == nullptr || it->order < foundOrder)) {
+      found = it->sec;
+      foundOrder = it->order;
     }
   }
 
-  return false;
+  if (found == nullptr) {
+    return false;
+  }
+
+  sec = found;
+  return true;
+}
+
+static bool parseDirectories(parsed_pe *p, ::uint32_t mask);
+
+/*
+ * Make sure the directory behind one of the Iter functions has been read.
+ * In lazy mode that happens here, the first time it is asked for. Anything
+ * a failed parse left behind is thrown away so callers never see half a
+ * directory.
+ */
+static bool ensureParsed(parsed_pe *p, ::uint32_t dir) {
+  parsed_pe_internal *pint = p->internal;
+
+  if ((pint->flags & dir) == 0 || (pint->parsed & dir) != 0) {
+    return true;
+  }
+
+  return parseDirectories(p, dir);
+}
+
+template <class T>
+static void ensureParsed(parsed_pe *p, ::uint32_t dir, T &entries) {
+  if (!ensureParsed(p, dir)) {
+    entries.clear();
+  }
 }
 
 void IterRsrc(parsed_pe *pe, iterRsrc cb, void *cbd) {
   parsed_pe_internal *pint = pe->internal;
 
+  ensureParsed(pe, PE_PARSE_RESOURCES, pint->rsrcs);
+
   for (resource r : pint->rsrcs) {
     if (cb(cbd, r) != 0) {
       break;
@@ -191,28 +919,30 @@ void IterRsrc(parsed_pe *pe, iterRsrc cb, void *cbd) {
 }
 
 bool parse_resource_id(bounded_buffer *data, ::uint32_t id, string &result) {
-  ::uint8_t c;
   ::uint16_t len;
 
   if (!readWord(data, id, len)) {
     return false;
   }
   id += 2;
-  for (::uint32_t i = 0; i < len * 2; i++) {
-    if (!readByte(data, id + i, c)) {
-      return false;
-    }
-    result.push_back((char) c);
+
+  // the name is len UTF-16 characters, kept as raw bytes
+  pe_string_view name;
+  if (!readFixedString(data, id, len * 2, name)) {
+    return false;
   }
+
+  result.assign(name.begin(), name.end());
   return true;
 }
 
-bool parse_resource_table(bounded_buffer *sectionData,
+bool parse_resource_table(arena &mem,
+                          bounded_buffer *sectionData,
                           ::uint32_t o,
                           ::uint32_t virtaddr,
                           ::uint32_t depth,
                           resource_dir_entry *dirent,
-                          list<resource> &rsrcs) {
+                          arena_vector<resource> &rsrcs) {
   ::uint32_t i = 0;
   resource_dir_table rdt;
 
@@ -234,26 +964,15 @@ bool parse_resource_table(bounded_buffer *sectionData,
   }
 
   for (i = 0; i < rdt.NameEntries + rdt.IDEntries; i++) {
+    // The top level has nothing to inherit, it works in an entry of its own.
+    resource_dir_entry topEntry;
     resource_dir_entry *rde = dirent;
     if (dirent == nullptr) {
-      rde = new resource_dir_entry;
-    }
-
-    if (!readDword(sectionData, o + _offset(__typeof__(*rde), ID), rde->ID)) {
-      PE_ERR(PEERR_READ);
-      if (dirent == nullptr) {
-        delete rde;
-      }
-      return false;
+      rde = &topEntry;
     }
 
-    if (!readDword(sectionData, o + _offset(__typeof__(*rde), RVA), rde->RVA)) {
-      PE_ERR(PEERR_READ);
-      if (dirent == nullptr) {
-        delete rde;
-      }
-      return false;
-    }
+    READ_DWORD_PTR(sectionData, o, rde, ID);
+    READ_DWORD_PTR(sectionData, o, rde, RVA);
 
     o += sizeof(resource_dir_entry_sz);
 
@@ -262,9 +981,6 @@ bool parse_resource_table(bounded_buffer *sectionData,
       if (i < rdt.NameEntries) {
         if (!parse_resource_id(
                 sectionData, rde->ID & 0x0FFFFFFF, rde->type_str)) {
-          if (dirent == nullptr) {
-            delete rde;
-          }
           return false;
         }
       }
@@ -273,9 +989,6 @@ bool parse_resource_table(bounded_buffer *sectionData,
       if (i < rdt.NameEntries) {
         if (!parse_resource_id(
                 sectionData, rde->ID & 0x0FFFFFFF, rde->name_str)) {
-          if (dirent == nullptr) {
-            delete rde;
-          }
           return false;
         }
       }
@@ -284,9 +997,6 @@ bool parse_resource_table(bounded_buffer *sectionData,
       if (i < rdt.NameEntries) {
         if (!parse_resource_id(
                 sectionData, rde->ID & 0x0FFFFFFF, rde->lang_str)) {
-          if (dirent == nullptr) {
-            delete rde;
-          }
           return false;
         }
       }
@@ -295,15 +1005,13 @@ bool parse_resource_table(bounded_buffer *sectionData,
     // High bit 0 = RVA to RDT.
     // High bit 1 = RVA to RDE.
     if (rde->RVA & 0x80000000) {
-      if (!parse_resource_table(sectionData,
+      if (!parse_resource_table(mem,
+                                sectionData,
                                 rde->RVA & 0x0FFFFFFF,
                                 virtaddr,
                                 depth + 1,
                                 rde,
                                 rsrcs)) {
-        if (dirent == nullptr) {
-          delete rde;
-        }
         return false;
       }
     } else {
@@ -318,45 +1026,10 @@ bool parse_resource_table(bounded_buffer *sectionData,
        * but meh.
        */
 
-      if (!readDword(sectionData,
-                     rde->RVA + _offset(__typeof__(rdat), RVA),
-                     rdat.RVA)) {
-        PE_ERR(PEERR_READ);
-        if (dirent == nullptr) {
-          delete rde;
-        }
-        return false;
-      }
-
-      if (!readDword(sectionData,
-                     rde->RVA + _offset(__typeof__(rdat), size),
-                     rdat.size)) {
-        PE_ERR(PEERR_READ);
-        if (dirent == nullptr) {
-          delete rde;
-        }
-        return false;
-      }
-
-      if (!readDword(sectionData,
-                     rde->RVA + _offset(__typeof__(rdat), codepage),
-                     rdat.codepage)) {
-        PE_ERR(PEERR_READ);
-        if (dirent == nullptr) {
-          delete rde;
-        }
-        return false;
-      }
-
-      if (!readDword(sectionData,
-                     rde->RVA + _offset(__typeof__(rdat), reserved),
-                     rdat.reserved)) {
-        PE_ERR(PEERR_READ);
-        if (dirent == nullptr) {
-          delete rde;
-        }
-        return false;
-      }
+      READ_DWORD(sectionData, rde->RVA, rdat, RVA);
+      READ_DWORD(sectionData, rde->RVA, rdat, size);
+      READ_DWORD(sectionData, rde->RVA, rdat, codepage);
+      READ_DWORD(sectionData, rde->RVA, rdat, reserved);
 
       resource rsrc = {};
 
@@ -379,19 +1052,17 @@ bool parse_resource_table(bounded_buffer *sectionData,
        * a zero length buffer.
        */
       if (start > rdat.RVA) {
-        rsrc.buf = splitBuffer(sectionData, 0, 0);
+        rsrc.buf = splitBufferInArena(mem, sectionData, 0, 0);
       } else {
-        rsrc.buf = splitBuffer(sectionData, start, start + rdat.size);
+        rsrc.buf =
+            splitBufferInArena(mem, sectionData, start, start + rdat.size);
         if (rsrc.buf == nullptr) {
-          rsrc.buf = splitBuffer(sectionData, 0, 0);
+          rsrc.buf = splitBufferInArena(mem, sectionData, 0, 0);
         }
       }
 
       /* If we can't get even a zero length buffer, something is very wrong. */
       if (rsrc.buf == nullptr) {
-        if (dirent == nullptr) {
-          delete rde;
-        }
         return false;
       }
 
@@ -405,30 +1076,27 @@ bool parse_resource_table(bounded_buffer *sectionData,
     } else if (depth == 2) {
       rde->lang_str.clear();
     }
-
-    if (dirent == nullptr) {
-      delete rde;
-    }
   }
 
   return true;
 }
 
-bool getResources(bounded_buffer *b,
+bool getResources(arena &mem,
+                  bounded_buffer *b,
                   bounded_buffer *fileBegin,
-                  list<section> secs,
-                  list<resource> &rsrcs) {
+                  const arena_vector<section> &secs,
+                  arena_vector<resource> &rsrcs) {
 
   if (b == nullptr)
     return false;
 
-  for (section s : secs) {
+  for (const section &s : secs) {
     if (s.sectionName != ".rsrc") {
       continue;
     }
 
     if (!parse_resource_table(
-            s.sectionData, 0, s.sec.VirtualAddress, 0, nullptr, rsrcs)) {
+            mem, s.sectionData, 0, s.sec.VirtualAddress, 0, nullptr, rsrcs)) {
       return false;
     }
 
@@ -438,46 +1106,42 @@ bool getResources(bounded_buffer *b,
   return true;
 }
 
-bool getSections(bounded_buffer *b,
+bool getSections(arena &mem,
+                 bounded_buffer *b,
                  bounded_buffer *fileBegin,
                  nt_header_32 &nthdr,
-                 list<section> &secs) {
+                 arena_vector<section> &secs,
+                 arena_vector<section_interval> &secIndex) {
   if (b == nullptr) {
     return false;
   }
 
+  secs.reserve(nthdr.FileHeader.NumberOfSections);
+
   // get each of the sections...
   for (::uint32_t i = 0; i < nthdr.FileHeader.NumberOfSections; i++) {
     image_section_header curSec;
 
     ::uint32_t o = i * sizeof(image_section_header);
-    for (::uint32_t k = 0; k < NT_SHORT_NAME_LEN; k++) {
-      if (!readByte(b, o + k, curSec.Name[k])) {
-        return false;
-      }
+    if (!readStruct(b, o, curSec)) {
+      PE_ERR(PEERR_READ);
+      return false;
     }
 
-    READ_DWORD(b, o, curSec, Misc.VirtualSize);
-    READ_DWORD(b, o, curSec, VirtualAddress);
-    READ_DWORD(b, o, curSec, SizeOfRawData);
-    READ_DWORD(b, o, curSec, PointerToRawData);
-    READ_DWORD(b, o, curSec, PointerToRelocations);
-    READ_DWORD(b, o, curSec, PointerToLinenumbers);
-    READ_WORD(b, o, curSec, NumberOfRelocations);
-    READ_WORD(b, o, curSec, NumberOfLinenumbers);
-    READ_DWORD(b, o, curSec, Characteristics);
-
     // now we have the section header information, so fill in a section
     // object appropriately
     section thisSec;
-    for (::uint32_t i = 0; i < NT_SHORT_NAME_LEN; i++) {
-      ::uint8_t c = curSec.Name[i];
-      if (c == 0) {
-        break;
-      }
+    ::uint32_t nameLen = 0;
+    while (nameLen < NT_SHORT_NAME_LEN && curSec.Name[nameLen] != 0) {
+      nameLen++;
+    }
 
-      thisSec.sectionName.push_back((char) c);
+    const char *name = mem.copy(curSec.Name, nameLen);
+    if (name == nullptr) {
+      PE_ERR(PEERR_MEM);
+      return false;
     }
+    thisSec.sectionName = pe_string_view(name, nameLen);
 
     if (nthdr.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
       thisSec.sectionBase =
@@ -490,135 +1154,49 @@ bool getSections(bounded_buffer *b,
     }
 
     thisSec.sec = curSec;
-    ::uint32_t lowOff = curSec.PointerToRawData;
-    ::uint32_t highOff = lowOff + curSec.SizeOfRawData;
-    thisSec.sectionData = splitBuffer(fileBegin, lowOff, highOff);
+    ::uint64_t lowOff = curSec.PointerToRawData;
+    ::uint64_t highOff = lowOff + curSec.SizeOfRawData;
+    thisSec.sectionData =
+        splitBufferInArena(mem, fileBegin, lowOff, highOff);
 
     secs.push_back(thisSec);
   }
 
-  return true;
-}
-
-bool readOptionalHeader(bounded_buffer *b, optional_header_32 &header) {
-  READ_WORD(b, 0, header, Magic);
-
-  READ_BYTE(b, 0, header, MajorLinkerVersion);
-  READ_BYTE(b, 0, header, MinorLinkerVersion);
-  READ_DWORD(b, 0, header, SizeOfCode);
-  READ_DWORD(b, 0, header, SizeOfInitializedData);
-  READ_DWORD(b, 0, header, SizeOfUninitializedData);
-  READ_DWORD(b, 0, header, AddressOfEntryPoint);
-  READ_DWORD(b, 0, header, BaseOfCode);
-  READ_DWORD(b, 0, header, BaseOfData);
-  READ_DWORD(b, 0, header, ImageBase);
-  READ_DWORD(b, 0, header, SectionAlignment);
-  READ_DWORD(b, 0, header, FileAlignment);
-  READ_WORD(b, 0, header, MajorOperatingSystemVersion);
-  READ_WORD(b, 0, header, MinorOperatingSystemVersion);
-  READ_WORD(b, 0, header, MajorImageVersion);
-  READ_WORD(b, 0, header, MinorImageVersion);
-  READ_WORD(b, 0, header, MajorSubsystemVersion);
-  READ_WORD(b, 0, header, MinorSubsystemVersion);
-  READ_DWORD(b, 0, header, Win32VersionValue);
-  READ_DWORD(b, 0, header, SizeOfImage);
-  READ_DWORD(b, 0, header, SizeOfHeaders);
-  READ_DWORD(b, 0, header, CheckSum);
-  READ_WORD(b, 0, header, Subsystem);
-  READ_WORD(b, 0, header, DllCharacteristics);
-  READ_DWORD(b, 0, header, SizeOfStackReserve);
-  READ_DWORD(b, 0, header, SizeOfStackCommit);
-  READ_DWORD(b, 0, header, SizeOfHeapReserve);
-  READ_DWORD(b, 0, header, SizeOfHeapCommit);
-  READ_DWORD(b, 0, header, LoaderFlags);
-  READ_DWORD(b, 0, header, NumberOfRvaAndSizes);
-
-  if (header.NumberOfRvaAndSizes > NUM_DIR_ENTRIES) {
-    header.NumberOfRvaAndSizes = NUM_DIR_ENTRIES;
-  }
-
-  for (::uint32_t i = 0; i < header.NumberOfRvaAndSizes; i++) {
-    ::uint32_t c = (i * sizeof(data_directory));
-    c += _offset(optional_header_32, DataDirectory[0]);
-    ::uint32_t o;
-
-    o = c + _offset(data_directory, VirtualAddress);
-    if (!readDword(b, o, header.DataDirectory[i].VirtualAddress)) {
-      return false;
-    }
-
-    o = c + _offset(data_directory, Size);
-    if (!readDword(b, o, header.DataDirectory[i].Size)) {
-      return false;
-    }
-  }
+  buildSecIndex(secs, secIndex);
 
   return true;
 }
 
-bool readOptionalHeader64(bounded_buffer *b, optional_header_64 &header) {
-  READ_WORD(b, 0, header, Magic);
-
-  READ_BYTE(b, 0, header, MajorLinkerVersion);
-  READ_BYTE(b, 0, header, MinorLinkerVersion);
-  READ_DWORD(b, 0, header, SizeOfCode);
-  READ_DWORD(b, 0, header, SizeOfInitializedData);
-  READ_DWORD(b, 0, header, SizeOfUninitializedData);
-  READ_DWORD(b, 0, header, AddressOfEntryPoint);
-  READ_DWORD(b, 0, header, BaseOfCode);
-  READ_QWORD(b, 0, header, ImageBase);
-  READ_DWORD(b, 0, header, SectionAlignment);
-  READ_DWORD(b, 0, header, FileAlignment);
-  READ_WORD(b, 0, header, MajorOperatingSystemVersion);
-  READ_WORD(b, 0, header, MinorOperatingSystemVersion);
-  READ_WORD(b, 0, header, MajorImageVersion);
-  READ_WORD(b, 0, header, MinorImageVersion);
-  READ_WORD(b, 0, header, MajorSubsystemVersion);
-  READ_WORD(b, 0, header, MinorSubsystemVersion);
-  READ_DWORD(b, 0, header, Win32VersionValue);
-  READ_DWORD(b, 0, header, SizeOfImage);
-  READ_DWORD(b, 0, header, SizeOfHeaders);
-  READ_DWORD(b, 0, header, CheckSum);
-  READ_WORD(b, 0, header, Subsystem);
-  READ_WORD(b, 0, header, DllCharacteristics);
-  READ_QWORD(b, 0, header, SizeOfStackReserve);
-  READ_QWORD(b, 0, header, SizeOfStackCommit);
-  READ_QWORD(b, 0, header, SizeOfHeapReserve);
-  READ_QWORD(b, 0, header, SizeOfHeapCommit);
-  READ_DWORD(b, 0, header, LoaderFlags);
-  READ_DWORD(b, 0, header, NumberOfRvaAndSizes);
+/*
+ * PE32 and PE32+ optional headers only differ in the fields before the
+ * data directories, so both are read by this one function.
+ */
+template <class T>
+static bool readOptionalHeader(bounded_buffer *b, T &header) {
+  ::uint32_t dirOff = _offset(T, DataDirectory);
+
+  if (!readStruct(b, 0, header, dirOff)) {
+    PE_ERR(PEERR_READ);
+    return false;
+  }
 
   if (header.NumberOfRvaAndSizes > NUM_DIR_ENTRIES) {
     header.NumberOfRvaAndSizes = NUM_DIR_ENTRIES;
   }
 
-  for (::uint32_t i = 0; i < header.NumberOfRvaAndSizes; i++) {
-    ::uint32_t c = (i * sizeof(data_directory));
-    c += _offset(optional_header_64, DataDirectory[0]);
-    ::uint32_t o;
-
-    o = c + _offset(data_directory, VirtualAddress);
-    if (!readDword(b, o, header.DataDirectory[i].VirtualAddress)) {
-      return false;
-    }
-
-    o = c + _offset(data_directory, Size);
-    if (!readDword(b, o, header.DataDirectory[i].Size)) {
-      return false;
-    }
+  if (!readStructs(
+          b, dirOff, header.DataDirectory, header.NumberOfRvaAndSizes)) {
+    return false;
   }
 
   return true;
 }
 
 bool readFileHeader(bounded_buffer *b, file_header &header) {
-  READ_WORD(b, 0, header, Machine);
-  READ_WORD(b, 0, header, NumberOfSections);
-  READ_DWORD(b, 0, header, TimeDateStamp);
-  READ_DWORD(b, 0, header, PointerToSymbolTable);
-  READ_DWORD(b, 0, header, NumberOfSymbols);
-  READ_WORD(b, 0, header, SizeOfOptionalHeader);
-  READ_WORD(b, 0, header, Characteristics);
+  if (!readStruct(b, 0, header)) {
+    PE_ERR(PEERR_READ);
+    return false;
+  }
 
   return true;
 }
@@ -711,7 +1289,7 @@ bool readNtHeader(bounded_buffer *b, nt_header_32 &header) {
       return false;
     }
   } else if (header.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-    if (!readOptionalHeader64(ohb, header.OptionalHeader64)) {
+    if (!readOptionalHeader(ohb, header.OptionalHeader64)) {
       deleteBuffer(ohb);
       deleteBuffer(fhb);
       return false;
@@ -729,24 +1307,111 @@ bool readNtHeader(bounded_buffer *b, nt_header_32 &header) {
   return true;
 }
 
-bool getHeader(bounded_buffer *file, pe_header &p, bounded_buffer *&rem) {
-  if (file == nullptr) {
-    return false;
+static inline ::uint32_t rotl32(::uint32_t v, ::uint32_t n) {
+  n &= 31;
+  return n == 0 ? v : (v << n) | (v >> (32 - n));
+}
+
+/*
+ * Decode the Rich header, which sits in front of the NT headers at end. It
+ * is found by its "Rich" trailer, which is followed by the XOR key, and
+ * the records are walked back from there to the masked "DanS" marker. The
+ * key is a checksum of the DOS header, minus e_lfanew, and of the records,
+ * each rotated left by its count.
+ */
+static void
+getRichHeader(bounded_buffer *file, ::uint32_t end, rich_header &rich) {
+  rich.present = false;
+
+  ::uint32_t trailer = 0;
+  for (::uint32_t off = sizeof(dos_header); off + 8 <= end; off += 4) {
+    ::uint32_t v;
+    if (!readDword(file, off, v)) {
+      return;
+    }
+    if (v == RICH_SIGNATURE) {
+      trailer = off;
+      break;
+    }
   }
 
-  // start by reading MZ
-  ::uint16_t tmp = 0;
-  ::uint32_t curOffset = 0;
-  if (!readWord(file, curOffset, tmp)) {
-    PE_ERR(PEERR_READ);
-    return false;
+  ::uint32_t key;
+  if (trailer == 0 || !readDword(file, trailer + 4, key)) {
+    return;
   }
-  if (tmp != MZ_MAGIC) {
-    PE_ERR(PEERR_MAGIC);
-    return false;
+
+  // DanS is followed by three zero dwords before the records start
+  ::uint32_t start = 0;
+  for (::uint32_t off = trailer; off >= sizeof(dos_header) + 4;) {
+    off -= 4;
+    ::uint32_t v;
+    if (!readDword(file, off, v)) {
+      return;
+    }
+    if ((v ^ key) == RICH_DANS_SIGNATURE) {
+      start = off;
+      break;
+    }
   }
 
-  // read the offset to the NT headers
+  if (start == 0 || trailer - start < 16 || (trailer - start) % 8 != 0) {
+    return;
+  }
+
+  ::uint32_t sum = start;
+  for (::uint32_t i = 0; i < start; i++) {
+    if (i >= _offset(dos_header, e_lfanew) &&
+        i < _offset(dos_header, e_lfanew) + sizeof(::uint32_t)) {
+      continue;
+    }
+    sum += rotl32(file->buf[i], i);
+  }
+
+  rich.count = 0;
+  rich.totalEntries = 0;
+  for (::uint32_t off = start + 16; off < trailer; off += 8) {
+    ::uint32_t compId;
+    ::uint32_t count;
+    if (!readDword(file, off, compId) || !readDword(file, off + 4, count)) {
+      return;
+    }
+    compId ^= key;
+    count ^= key;
+    sum += rotl32(compId, count);
+
+    if (rich.count < RICH_MAX_ENTRIES) {
+      rich_entry &e = rich.entries[rich.count++];
+      e.productId = static_cast<::uint16_t>(compId >> 16);
+      e.build = static_cast<::uint16_t>(compId);
+      e.count = count;
+    }
+    rich.totalEntries++;
+  }
+
+  rich.present = true;
+  rich.checksumValid = sum == key;
+  rich.key = key;
+  rich.offset = start;
+}
+
+bool getHeader(bounded_buffer *file, pe_header &p, bounded_buffer *&rem) {
+  if (file == nullptr) {
+    return false;
+  }
+
+  // start by reading MZ
+  ::uint16_t tmp = 0;
+  ::uint32_t curOffset = 0;
+  if (!readWord(file, curOffset, tmp)) {
+    PE_ERR(PEERR_READ);
+    return false;
+  }
+  if (tmp != MZ_MAGIC) {
+    PE_ERR(PEERR_MAGIC);
+    return false;
+  }
+
+  // read the offset to the NT headers
   ::uint32_t offset;
   if (!readDword(file, _offset(dos_header, e_lfanew), offset)) {
     PE_ERR(PEERR_READ);
@@ -754,6 +1419,9 @@ bool getHeader(bounded_buffer *file, pe_header &p, bounded_buffer *&rem) {
   }
   curOffset += offset;
 
+  // the Rich header lives between the DOS header and the NT headers
+  getRichHeader(file, offset, p.rich);
+
   // now, we can read out the fields of the NT headers
   bounded_buffer *ntBuf = splitBuffer(file, curOffset, file->bufLen);
 
@@ -791,277 +1459,310 @@ bool getHeader(bounded_buffer *file, pe_header &p, bounded_buffer *&rem) {
   return true;
 }
 
-bool getExports(parsed_pe *p) {
-  data_directory exportDir;
-  if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-    exportDir = p->peHeader.nt.OptionalHeader.DataDirectory[DIR_EXPORT];
-  } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-    exportDir = p->peHeader.nt.OptionalHeader64.DataDirectory[DIR_EXPORT];
-  } else {
-    return false;
+/*
+ * What the directory parsers need to know about PE32 and PE32+. They are
+ * instantiated for each of the two, and the format is picked once per
+ * parse instead of being tested for every entry.
+ */
+template <class T>
+struct pe_format;
+
+template <>
+struct pe_format<optional_header_32> {
+  // the width of an ImageBase and of an import thunk
+  typedef ::uint32_t ptr;
+  typedef tls_dir_32 tls_dir;
+  typedef load_config_32 load_config;
+
+  static const optional_header_32 &header(const parsed_pe *p) {
+    return p->peHeader.nt.OptionalHeader;
   }
 
-  if (exportDir.Size != 0) {
-    section s;
-    VA addr;
-    if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-      addr = exportDir.VirtualAddress + p->peHeader.nt.OptionalHeader.ImageBase;
-    } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-      addr =
-          exportDir.VirtualAddress + p->peHeader.nt.OptionalHeader64.ImageBase;
-    } else {
-      return false;
-    }
+  static bool readPtr(bounded_buffer *b, ::uint64_t off, ptr &out) {
+    return readDword(b, off, out);
+  }
 
-    if (!getSecForVA(p->internal->secs, addr, s)) {
-      return false;
-    }
+  // a ptr as a field, for reading arrays of them with readFields
+  static const field_desc ptrFields[];
+};
 
-    ::uint32_t rvaofft = addr - s.sectionBase;
+const field_desc pe_format<optional_header_32>::ptrFields[] = {
+    {0, sizeof(ptr), 1}, FIELD_END};
 
-    // get the name of this module
-    ::uint32_t nameRva;
-    if (!readDword(s.sectionData,
-                   rvaofft + _offset(export_dir_table, NameRVA),
-                   nameRva)) {
-      return false;
-    }
+template <>
+struct pe_format<optional_header_64> {
+  typedef ::uint64_t ptr;
+  typedef tls_dir_64 tls_dir;
+  typedef load_config_64 load_config;
 
-    VA nameVA;
-    if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-      nameVA = nameRva + p->peHeader.nt.OptionalHeader.ImageBase;
-    } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-      nameVA = nameRva + p->peHeader.nt.OptionalHeader64.ImageBase;
-    } else {
-      return false;
-    }
+  static const optional_header_64 &header(const parsed_pe *p) {
+    return p->peHeader.nt.OptionalHeader64;
+  }
 
-    section nameSec;
-    if (!getSecForVA(p->internal->secs, nameVA, nameSec)) {
-      return false;
-    }
+  static bool readPtr(bounded_buffer *b, ::uint64_t off, ptr &out) {
+    return readQword(b, off, out);
+  }
 
-    ::uint32_t nameOff = nameVA - nameSec.sectionBase;
-    string modName;
-    if (!readCString(*nameSec.sectionData, nameOff, modName)) {
-      return false;
-    }
+  static const field_desc ptrFields[];
+};
+
+const field_desc pe_format<optional_header_64>::ptrFields[] = {
+    {0, sizeof(ptr), 1}, FIELD_END};
 
-    // now, get all the named export symbols
-    ::uint32_t numNames;
-    if (!readDword(s.sectionData,
-                   rvaofft + _offset(export_dir_table, NumberOfNamePointers),
-                   numNames)) {
+/*
+ * Read the NUL terminated string at v. Export names are usually packed
+ * together, so the section of the previous string is tried before the
+ * section index is searched.
+ */
+static bool readStringAtVA(parsed_pe *p,
+                           VA v,
+                           const section *&sec,
+                           pe_string_view &result) {
+  if (sec == nullptr || v < sec->sectionBase ||
+      v - sec->sectionBase >= sec->sec.Misc.VirtualSize) {
+    if (!getSecForVA(p->internal->secIndex, v, sec)) {
+      sec = nullptr;
       return false;
     }
+  }
 
-    if (numNames > 0) {
-      // get the names section
-      ::uint32_t namesRVA;
-      if (!readDword(s.sectionData,
-                     rvaofft + _offset(export_dir_table, NamePointerRVA),
-                     namesRVA)) {
-        return false;
-      }
+  return readCString(
+      p->internal->mem, sec->sectionData, v - sec->sectionBase, result);
+}
 
-      VA namesVA;
-      if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-        namesVA = namesRVA + p->peHeader.nt.OptionalHeader.ImageBase;
-      } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-        namesVA = namesRVA + p->peHeader.nt.OptionalHeader64.ImageBase;
-      } else {
-        return false;
-      }
+// add the export whose EAT slot holds symRVA, which lies at symVA
+static bool addExport(parsed_pe *p,
+                      const data_directory &exportDir,
+                      ::uint32_t symRVA,
+                      VA symVA,
+                      ::uint32_t ordinal,
+                      const pe_string_view &symName,
+                      const pe_string_view &modName,
+                      const section *&strSec) {
+  exportent a;
+
+  a.addr = symVA;
+  a.ordinal = ordinal;
+  a.symbolName = symName;
+  a.moduleName = modName;
+
+  // a slot pointing back into the export directory holds the name of the
+  // export it is forwarded to rather than code
+  if (symRVA >= exportDir.VirtualAddress &&
+      symRVA - exportDir.VirtualAddress < exportDir.Size) {
+    if (!readStringAtVA(p, symVA, strSec, a.forwarderName)) {
+      return false;
+    }
+  }
 
-      section namesSec;
-      if (!getSecForVA(p->internal->secs, namesVA, namesSec)) {
-        return false;
-      }
+  p->internal->exports.push_back(a);
+  return true;
+}
 
-      ::uint32_t namesOff = namesVA - namesSec.sectionBase;
+// find the section holding the table at v and the offset of v in it
+static bool getTable(parsed_pe *p,
+                     VA v,
+                     const section *&sec,
+                     ::uint32_t &off) {
+  if (!getSecForVA(p->internal->secIndex, v, sec)) {
+    return false;
+  }
 
-      // get the EAT section
-      ::uint32_t eatRVA;
-      if (!readDword(s.sectionData,
-                     rvaofft + _offset(export_dir_table, ExportAddressTableRVA),
-                     eatRVA)) {
-        return false;
-      }
+  off = static_cast<::uint32_t>(v - sec->sectionBase);
+  return true;
+}
 
-      VA eatVA;
-      if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-        eatVA = eatRVA + p->peHeader.nt.OptionalHeader.ImageBase;
-      } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-        eatVA = eatRVA + p->peHeader.nt.OptionalHeader64.ImageBase;
-      } else {
-        return false;
-      }
+/*
+ * Walk the export directory. Named exports come first, in name table order,
+ * followed by the EAT slots no name refers to, which are the ordinal only
+ * exports. The tables are located once and then read by offset, so this is
+ * linear in their size.
+ */
+template <class T>
+static bool getExports(parsed_pe *p) {
+  typedef typename pe_format<T>::ptr ptr;
+  const T &hdr = pe_format<T>::header(p);
+  const ptr imageBase = hdr.ImageBase;
+  data_directory exportDir = hdr.DataDirectory[DIR_EXPORT];
+
+  if (exportDir.Size == 0) {
+    return true;
+  }
 
-      section eatSec;
-      if (!getSecForVA(p->internal->secs, eatVA, eatSec)) {
-        return false;
-      }
+  const section *s;
+  ::uint32_t rvaofft;
+  if (!getTable(p, exportDir.VirtualAddress + imageBase, s, rvaofft)) {
+    return false;
+  }
 
-      ::uint32_t eatOff = eatVA - eatSec.sectionBase;
+  export_dir_table ed;
+  if (!readStruct(s->sectionData, rvaofft, ed)) {
+    return false;
+  }
+  p->internal->expOrdinalBase = ed.OrdinalBase;
 
-      // get the ordinal base
-      ::uint32_t ordinalBase;
-      if (!readDword(s.sectionData,
-                     rvaofft + _offset(export_dir_table, OrdinalBase),
-                     ordinalBase)) {
-        return false;
-      }
+  // get the name of this module
+  const section *strSec = nullptr;
+  pe_string_view modName;
+  if (!readStringAtVA(p, ed.NameRVA + imageBase, strSec, modName)) {
+    return false;
+  }
 
-      // get the ordinal table
-      ::uint32_t ordinalTableRVA;
-      if (!readDword(s.sectionData,
-                     rvaofft + _offset(export_dir_table, OrdinalTableRVA),
-                     ordinalTableRVA)) {
-        return false;
-      }
+  ::uint32_t numNames = ed.NumberOfNamePointers;
+  if (numNames == 0 && ed.AddressTableEntries == 0) {
+    return true;
+  }
 
-      VA ordinalTableVA;
-      if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-        ordinalTableVA =
-            ordinalTableRVA + p->peHeader.nt.OptionalHeader.ImageBase;
-      } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-        ordinalTableVA =
-            ordinalTableRVA + p->peHeader.nt.OptionalHeader64.ImageBase;
-      } else {
-        return false;
-      }
+  // the names need the EAT, but a directory without any can do without it,
+  // and a truncated EAT only has the slots that are in the file
+  const section *eatSec = nullptr;
+  ::uint32_t eatOff = 0;
+  ::uint32_t numFuncs = 0;
+  if (getTable(p, ed.ExportAddressTableRVA + imageBase, eatSec, eatOff)) {
+    numFuncs = std::min(ed.AddressTableEntries,
+                        bytesAvailable(eatSec->sectionData, eatOff) /
+                            static_cast<::uint32_t>(sizeof(::uint32_t)));
+  } else if (numNames > 0) {
+    return false;
+  }
 
-      section ordinalTableSec;
-      if (!getSecForVA(p->internal->secs, ordinalTableVA, ordinalTableSec)) {
-        return false;
-      }
+  const section *namesSec = nullptr;
+  const section *ordinalTableSec = nullptr;
+  ::uint32_t namesOff = 0;
+  ::uint32_t ordinalOff = 0;
+  if (numNames > 0) {
+    if (!getTable(p, ed.NamePointerRVA + imageBase, namesSec, namesOff) ||
+        !getTable(p,
+                  ed.OrdinalTableRVA + imageBase,
+                  ordinalTableSec,
+                  ordinalOff)) {
+      return false;
+    }
 
-      ::uint32_t ordinalOff = ordinalTableVA - ordinalTableSec.sectionBase;
+    // every name takes a pointer in the name table, so the table size
+    // bounds the number of exports a malformed count can make us reserve
+    numNames = std::min(numNames,
+                        bytesAvailable(namesSec->sectionData, namesOff) /
+                            static_cast<::uint32_t>(sizeof(::uint32_t)));
+  }
 
-      for (::uint32_t i = 0; i < numNames; i++) {
-        ::uint32_t curNameRVA;
-        if (!readDword(namesSec.sectionData,
-                       namesOff + (i * sizeof(::uint32_t)),
-                       curNameRVA)) {
-          return false;
-        }
+  p->internal->exports.reserve(std::max(numNames, numFuncs));
 
-        VA curNameVA;
-        if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-          curNameVA = curNameRVA + p->peHeader.nt.OptionalHeader.ImageBase;
-        } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-          curNameVA = curNameRVA + p->peHeader.nt.OptionalHeader64.ImageBase;
-        } else {
-          return false;
-        }
+  // EAT slots that have a name, usually all of them
+  arena_vector<::uint8_t> named(
+      numFuncs, 0, arena_allocator<::uint8_t>(&p->internal->mem));
+  ::uint32_t numNamed = 0;
 
-        section curNameSec;
+  for (::uint32_t i = 0; i < numNames; i++) {
+    ::uint32_t curNameRVA;
+    if (!readDword(namesSec->sectionData,
+                   namesOff + (i * sizeof(::uint32_t)),
+                   curNameRVA)) {
+      return false;
+    }
 
-        if (!getSecForVA(p->internal->secs, curNameVA, curNameSec)) {
-          return false;
-        }
+    pe_string_view symName;
+    if (!readStringAtVA(p, curNameRVA + imageBase, strSec, symName)) {
+      return false;
+    }
 
-        ::uint32_t curNameOff = curNameVA - curNameSec.sectionBase;
-        string symName;
-        ::uint8_t d;
+    // now, for this i, look it up in the ExportOrdinalTable
+    ::uint16_t ordinal;
+    if (!readWord(ordinalTableSec->sectionData,
+                  ordinalOff + (i * sizeof(uint16_t)),
+                  ordinal)) {
+      return false;
+    }
 
-        do {
-          if (!readByte(curNameSec.sectionData, curNameOff, d)) {
-            return false;
-          }
+    ::uint32_t symRVA;
+    if (!readDword(eatSec->sectionData,
+                   eatOff + (ordinal * sizeof(uint32_t)),
+                   symRVA)) {
+      return false;
+    }
 
-          if (d == 0) {
-            break;
-          }
+    if (!addExport(p,
+                   exportDir,
+                   symRVA,
+                   symRVA + imageBase,
+                   ed.OrdinalBase + ordinal,
+                   symName,
+                   modName,
+                   strSec)) {
+      return false;
+    }
 
-          symName.push_back(d);
-          curNameOff++;
-        } while (true);
+    if (ordinal < numFuncs && named[ordinal] == 0) {
+      named[ordinal] = 1;
+      numNamed++;
+    }
+  }
 
-        // now, for this i, look it up in the ExportOrdinalTable
-        ::uint16_t ordinal;
-        if (!readWord(ordinalTableSec.sectionData,
-                      ordinalOff + (i * sizeof(uint16_t)),
-                      ordinal)) {
-          return false;
-        }
+  for (::uint32_t i = 0; numNamed < numFuncs && i < numFuncs; i++) {
+    if (named[i] != 0) {
+      continue;
+    }
 
-        //::uint32_t  eatIdx = ordinal - ordinalBase;
-        ::uint32_t eatIdx = (ordinal * sizeof(uint32_t));
+    ::uint32_t symRVA;
+    if (!readDword(
+            eatSec->sectionData, eatOff + (i * sizeof(uint32_t)), symRVA)) {
+      return false;
+    }
 
-        ::uint32_t symRVA;
-        if (!readDword(eatSec.sectionData, eatOff + eatIdx, symRVA)) {
-          return false;
-        }
+    // unused slots in the ordinal range are zero
+    if (symRVA == 0) {
+      continue;
+    }
 
-        bool isForwarded =
-            ((symRVA >= exportDir.VirtualAddress) &&
-             (symRVA < exportDir.VirtualAddress + exportDir.Size));
-
-        if (!isForwarded) {
-          ::uint32_t symVA;
-          if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-            symVA = symRVA + p->peHeader.nt.OptionalHeader.ImageBase;
-          } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-            symVA = symRVA + p->peHeader.nt.OptionalHeader64.ImageBase;
-          } else {
-            return false;
-          }
-
-          exportent a;
-
-          a.addr = symVA;
-          a.symbolName = symName;
-          a.moduleName = modName;
-          p->internal->exports.push_back(a);
-        }
-      }
+    if (!addExport(p,
+                   exportDir,
+                   symRVA,
+                   symRVA + imageBase,
+                   ed.OrdinalBase + i,
+                   pe_string_view(),
+                   modName,
+                   strSec)) {
+      return false;
     }
   }
 
   return true;
 }
 
-bool getRelocations(parsed_pe *p) {
-  data_directory relocDir;
-  if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-    relocDir = p->peHeader.nt.OptionalHeader.DataDirectory[DIR_BASERELOC];
-  } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-    relocDir = p->peHeader.nt.OptionalHeader64.DataDirectory[DIR_BASERELOC];
-  } else {
-    return false;
-  }
+template <class T>
+static bool getRelocations(parsed_pe *p) {
+  typedef typename pe_format<T>::ptr ptr;
+  const T &hdr = pe_format<T>::header(p);
+  const ptr imageBase = hdr.ImageBase;
+  data_directory relocDir = hdr.DataDirectory[DIR_BASERELOC];
 
   if (relocDir.Size != 0) {
-    section d;
-    VA vaAddr;
-    if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-      vaAddr =
-          relocDir.VirtualAddress + p->peHeader.nt.OptionalHeader.ImageBase;
-    } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-      vaAddr =
-          relocDir.VirtualAddress + p->peHeader.nt.OptionalHeader64.ImageBase;
-    } else {
-      return false;
-    }
+    const section *d;
+    VA vaAddr = relocDir.VirtualAddress + imageBase;
 
-    if (!getSecForVA(p->internal->secs, vaAddr, d)) {
+    if (!getSecForVA(p->internal->secIndex, vaAddr, d)) {
       return false;
     }
 
-    ::uint32_t rvaofft = vaAddr - d.sectionBase;
+    ::uint32_t rvaofft = vaAddr - d->sectionBase;
+
+    // each relocation is a 16 bit entry, a little less than Size / 2 once
+    // the block headers are taken out
+    p->internal->relocs.reserve(
+        std::min(relocDir.Size, bytesAvailable(d->sectionData, rvaofft)) /
+        sizeof(::uint16_t));
 
     while (rvaofft < relocDir.Size) {
       ::uint32_t pageRva;
       ::uint32_t blockSize;
 
-      if (!readDword(d.sectionData,
+      if (!readDword(d->sectionData,
                      rvaofft + _offset(reloc_block, PageRVA),
                      pageRva)) {
         return false;
       }
 
-      if (!readDword(d.sectionData,
+      if (!readDword(d->sectionData,
                      rvaofft + _offset(reloc_block, BlockSize),
                      blockSize)) {
         return false;
@@ -1076,13 +1777,25 @@ bool getRelocations(parsed_pe *p) {
       // Skip the Page RVA and Block Size fields
       rvaofft += sizeof(reloc_block);
 
+      // a block running off the end of the section can't be read in full
+      if (entryCount >
+          bytesAvailable(d->sectionData, rvaofft) / sizeof(::uint16_t)) {
+        return false;
+      }
+
+      // make room for the whole block and fill it in place
+      arena_vector<reloc> &relocs = p->internal->relocs;
+      std::size_t first = relocs.size();
+      relocs.resize(first + entryCount);
+      reloc *r = relocs.data() + first;
+
       // Iterate over all of the block Type/Offset entries
       while (entryCount != 0) {
         ::uint16_t entry;
         ::uint8_t type;
         ::uint16_t offset;
 
-        if (!readWord(d.sectionData, rvaofft, entry)) {
+        if (!readWord(d->sectionData, rvaofft, entry)) {
           return false;
         }
 
@@ -1092,22 +1805,12 @@ bool getRelocations(parsed_pe *p) {
         offset = entry & ~0xf000;
 
         // Produce the VA of the relocation
-        ::uint32_t relocVA;
-        if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-          relocVA = pageRva + offset + p->peHeader.nt.OptionalHeader.ImageBase;
-        } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-          relocVA =
-              pageRva + offset + p->peHeader.nt.OptionalHeader64.ImageBase;
-        } else {
-          return false;
-        }
+        ::uint32_t relocVA = pageRva + offset + imageBase;
 
         // Store in our list
-        reloc r;
-
-        r.shiftedAddr = relocVA;
-        r.type = (reloc_type) type;
-        p->internal->relocs.push_back(r);
+        r->shiftedAddr = relocVA;
+        r->type = (reloc_type) type;
+        r++;
 
         entryCount--;
         rvaofft += sizeof(::uint16_t);
@@ -1118,44 +1821,115 @@ bool getRelocations(parsed_pe *p) {
   return true;
 }
 
-bool getImports(parsed_pe *p) {
-  data_directory importDir;
-  if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-    importDir = p->peHeader.nt.OptionalHeader.DataDirectory[DIR_IMPORT];
-  } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-    importDir = p->peHeader.nt.OptionalHeader64.DataDirectory[DIR_IMPORT];
-  } else {
+/*
+ * Walk the lookup table at lookupVA, whose entries correspond one to one
+ * with the address table at iatVA, and add an import for each entry. Names
+ * are found at the entry value plus nameBase, which is the image base
+ * unless the table holds VAs.
+ */
+template <class T>
+static bool walkThunks(parsed_pe *p,
+                       const pe_string_view &modName,
+                       VA lookupVA,
+                       typename pe_format<T>::ptr iatVA,
+                       typename pe_format<T>::ptr nameBase,
+                       arena_vector<importent> &imports) {
+  typedef typename pe_format<T>::ptr ptr;
+  const ::uint32_t thunkSize = sizeof(ptr);
+  const ptr ordinalFlag = static_cast<ptr>(1) << (sizeof(ptr) * 8 - 1);
+
+  const section *lookupSec;
+  if (!getSecForVA(p->internal->secIndex, lookupVA, lookupSec)) {
     return false;
   }
 
-  if (importDir.Size != 0) {
-    // get section for the RVA in importDir
-    section c;
-    VA addr;
-    if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-      addr = importDir.VirtualAddress + p->peHeader.nt.OptionalHeader.ImageBase;
-    } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-      addr =
-          importDir.VirtualAddress + p->peHeader.nt.OptionalHeader64.ImageBase;
-    } else {
+  ::uint64_t lookupOff = lookupVA - lookupSec->sectionBase;
+  ::uint32_t offInTable = 0;
+  do {
+    ptr val;
+    if (!pe_format<T>::readPtr(lookupSec->sectionData, lookupOff, val)) {
       return false;
     }
+    if (val == 0) {
+      break;
+    }
+
+    importent ent;
+    pe_string_view symName;
+
+    if ((val & ordinalFlag) == 0) {
+      // import by name
+      VA valVA = static_cast<ptr>(val + nameBase);
+      const section *symNameSec;
+
+      if (!getSecForVA(p->internal->secIndex, valVA, symNameSec)) {
+        return false;
+      }
+
+      ::uint32_t nameOff = valVA - symNameSec->sectionBase;
+      nameOff += sizeof(::uint16_t);
+      if (!readCString(p->internal->mem,
+                       symNameSec->sectionData,
+                       nameOff,
+                       symName)) {
+        return false;
+      }
+    } else {
+      ::uint16_t oval = static_cast<::uint16_t>(val & 0xFFFF);
+
+      if (!makeOrdinalName(p->internal->mem, modName, oval, symName)) {
+        PE_ERR(PEERR_MEM);
+        return false;
+      }
+    }
+
+    // okay now we know the pair... add it
+    ent.addr = static_cast<ptr>(iatVA + offInTable);
+    ent.symbolName = symName;
+    ent.moduleName = modName;
+    imports.push_back(ent);
+
+    lookupOff += thunkSize;
+    offInTable += thunkSize;
+  } while (true);
 
-    if (!getSecForVA(p->internal->secs, addr, c)) {
+  return true;
+}
+
+template <class T>
+static bool getImports(parsed_pe *p) {
+  typedef typename pe_format<T>::ptr ptr;
+  const T &hdr = pe_format<T>::header(p);
+  const ptr imageBase = hdr.ImageBase;
+  const ::uint32_t thunkSize = sizeof(ptr);
+  data_directory importDir = hdr.DataDirectory[DIR_IMPORT];
+
+  if (importDir.Size != 0) {
+    // get section for the RVA in importDir
+    const section *c;
+    VA addr = importDir.VirtualAddress + imageBase;
+
+    if (!getSecForVA(p->internal->secIndex, addr, c)) {
       return false;
     }
 
+    // the IAT holds one thunk per imported symbol plus a terminator per
+    // module, so its size is a close upper bound on the number of imports
+    data_directory iatDir = hdr.DataDirectory[DIR_IAT];
+    p->internal->imports.reserve(
+        std::min(iatDir.Size, bytesAvailable(p->fileBuffer, 0)) / thunkSize);
+
     // get import directory from this section
-    ::uint32_t offt = addr - c.sectionBase;
+    ::uint32_t offt = addr - c->sectionBase;
     do {
       // read each directory entry out
       import_dir_entry curEnt;
 
-      READ_DWORD(c.sectionData, offt, curEnt, LookupTableRVA);
-      READ_DWORD(c.sectionData, offt, curEnt, TimeStamp);
-      READ_DWORD(c.sectionData, offt, curEnt, ForwarderChain);
-      READ_DWORD(c.sectionData, offt, curEnt, NameRVA);
-      READ_DWORD(c.sectionData, offt, curEnt, AddressRVA);
+      READ_DWORD(c->sectionData, offt, curEnt, LookupTableRVA);
+      READ_DWORD(c->sectionData, offt, curEnt, TimeStamp);
+      READ_DWORD(c->sectionData, offt, curEnt, ForwarderChain);
+      READ_DWORD(c->sectionData, offt, curEnt, NameRVA);
+      READ_DWORD(c->sectionData, offt, curEnt, AddressRVA);
 
       // are all the fields in curEnt null? then we break
       if (curEnt.LookupTableRVA == 0 && curEnt.NameRVA == 0 &&
@@ -1164,165 +1938,40 @@ bool getImports(parsed_pe *p) {
       }
 
       // then, try and get the name of this particular module...
-      VA name;
-      if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-        name = curEnt.NameRVA + p->peHeader.nt.OptionalHeader.ImageBase;
-      } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-        name = curEnt.NameRVA + p->peHeader.nt.OptionalHeader64.ImageBase;
-      } else {
-        return false;
-      }
+      VA name = curEnt.NameRVA + imageBase;
 
-      section nameSec;
-      if (!getSecForVA(p->internal->secs, name, nameSec)) {
+      const section *nameSec;
+      if (!getSecForVA(p->internal->secIndex, name, nameSec)) {
         return false;
       }
 
-      ::uint32_t nameOff = name - nameSec.sectionBase;
-      string modName;
-      if (!readCString(*nameSec.sectionData, nameOff, modName)) {
+      ::uint32_t nameOff = name - nameSec->sectionBase;
+      pe_string_view modName;
+      if (!readCString(p->internal->mem,
+                       nameSec->sectionData,
+                       nameOff,
+                       modName,
+                       true)) {
         return false;
       }
-      std::transform(
-          modName.begin(), modName.end(), modName.begin(), ::toupper);
 
       // then, try and get all of the sub-symbols
       VA lookupVA = 0;
       if (curEnt.LookupTableRVA != 0) {
-        if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-          lookupVA =
-              curEnt.LookupTableRVA + p->peHeader.nt.OptionalHeader.ImageBase;
-        } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-          lookupVA =
-              curEnt.LookupTableRVA + p->peHeader.nt.OptionalHeader64.ImageBase;
-        } else {
-          return false;
-        }
+        lookupVA = curEnt.LookupTableRVA + imageBase;
       } else if (curEnt.AddressRVA != 0) {
-        if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-          lookupVA =
-              curEnt.AddressRVA + p->peHeader.nt.OptionalHeader.ImageBase;
-        } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-          lookupVA =
-              curEnt.AddressRVA + p->peHeader.nt.OptionalHeader64.ImageBase;
-        } else {
-          return false;
-        }
+        lookupVA = curEnt.AddressRVA + imageBase;
       }
 
-      section lookupSec;
-      if (lookupVA == 0 ||
-          !getSecForVA(p->internal->secs, lookupVA, lookupSec)) {
+      if (lookupVA == 0 || !walkThunks<T>(p,
+                                          modName,
+                                          lookupVA,
+                                          curEnt.AddressRVA + imageBase,
+                                          imageBase,
+                                          p->internal->imports)) {
         return false;
       }
 
-      ::uint64_t lookupOff = lookupVA - lookupSec.sectionBase;
-      ::uint32_t offInTable = 0;
-      do {
-        VA valVA = 0;
-        ::uint8_t ord = 0;
-        ::uint16_t oval = 0;
-        ::uint32_t val32 = 0;
-        ::uint64_t val64 = 0;
-        if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-          if (!readDword(lookupSec.sectionData, lookupOff, val32)) {
-            return false;
-          }
-          if (val32 == 0) {
-            break;
-          }
-          ord = (val32 >> 31);
-          oval = (val32 & ~0xFFFF0000);
-          valVA = val32 + p->peHeader.nt.OptionalHeader.ImageBase;
-        } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-          if (!readQword(lookupSec.sectionData, lookupOff, val64)) {
-            return false;
-          }
-          if (val64 == 0) {
-            break;
-          }
-          ord = (val64 >> 63);
-          oval = (val64 & ~0xFFFF0000);
-          valVA = val64 + p->peHeader.nt.OptionalHeader64.ImageBase;
-        } else {
-          return false;
-        }
-
-        if (ord == 0) {
-          // import by name
-          string symName;
-          section symNameSec;
-
-          if (!getSecForVA(p->internal->secs, valVA, symNameSec)) {
-            return false;
-          }
-
-          ::uint32_t nameOff = valVA - symNameSec.sectionBase;
-          nameOff += sizeof(::uint16_t);
-          do {
-            ::uint8_t d;
-
-            if (!readByte(symNameSec.sectionData, nameOff, d)) {
-              return false;
-            }
-
-            if (d == 0) {
-              break;
-            }
-
-            symName.push_back(d);
-            nameOff++;
-          } while (true);
-
-          // okay now we know the pair... add it
-          importent ent;
-
-          if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-            ent.addr = offInTable + curEnt.AddressRVA +
-                       p->peHeader.nt.OptionalHeader.ImageBase;
-          } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-            ent.addr = offInTable + curEnt.AddressRVA +
-                       p->peHeader.nt.OptionalHeader64.ImageBase;
-          } else {
-            return false;
-          }
-
-          ent.symbolName = symName;
-          ent.moduleName = modName;
-          p->internal->imports.push_back(ent);
-        } else {
-          string symName =
-              "ORDINAL_" + modName + "_" + to_string<uint32_t>(oval, dec);
-
-          importent ent;
-
-          if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-            ent.addr = offInTable + curEnt.AddressRVA +
-                       p->peHeader.nt.OptionalHeader.ImageBase;
-          } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-            ent.addr = offInTable + curEnt.AddressRVA +
-                       p->peHeader.nt.OptionalHeader64.ImageBase;
-          } else {
-            return false;
-          }
-
-          ent.symbolName = symName;
-          ent.moduleName = modName;
-
-          p->internal->imports.push_back(ent);
-        }
-
-        if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
-          lookupOff += sizeof(::uint32_t);
-          offInTable += sizeof(::uint32_t);
-        } else if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_64_MAGIC) {
-          lookupOff += sizeof(::uint64_t);
-          offInTable += sizeof(::uint64_t);
-        } else {
-          return false;
-        }
-      } while (true);
-
       offt += sizeof(import_dir_entry);
     } while (true);
   }
@@ -1330,407 +1979,2172 @@ bool getImports(parsed_pe *p) {
   return true;
 }
 
-bool getSymbolTable(parsed_pe *p) {
-  if (p->peHeader.nt.FileHeader.PointerToSymbolTable == 0) {
+/*
+ * Read the delay load directory, which names its tables like the import
+ * directory does. Descriptors without the RVA attribute come from old
+ * linkers that stored VAs, so those fields and the name table entries are
+ * taken as VAs.
+ */
+template <class T>
+static bool getDelayImports(parsed_pe *p) {
+  typedef typename pe_format<T>::ptr ptr;
+  const T &hdr = pe_format<T>::header(p);
+  const ptr imageBase = hdr.ImageBase;
+  data_directory delayDir = hdr.DataDirectory[DIR_DELAY_IMPORT];
+
+  if (delayDir.Size == 0) {
     return true;
   }
 
-  uint32_t strTableOffset =
-      p->peHeader.nt.FileHeader.PointerToSymbolTable +
-      (p->peHeader.nt.FileHeader.NumberOfSymbols * SYMTAB_RECORD_LEN);
-
-  uint32_t offset = p->peHeader.nt.FileHeader.PointerToSymbolTable;
-
-  for (uint32_t i = 0; i < p->peHeader.nt.FileHeader.NumberOfSymbols; i++) {
-    symbol sym;
+  const section *c;
+  if (!getSecForVA(
+          p->internal->secIndex, delayDir.VirtualAddress + imageBase, c)) {
+    return false;
+  }
 
-    // Read name
-    if (!readQword(p->fileBuffer, offset, sym.name.data)) {
-      PE_ERR(PEERR_MAGIC);
+  ::uint32_t offt = delayDir.VirtualAddress + imageBase - c->sectionBase;
+  do {
+    delay_import_dir_entry curEnt;
+    if (!readStruct(c->sectionData, offt, curEnt)) {
       return false;
     }
 
-    if (sym.name.zeroes == 0) {
-      // The symbol name is greater than 8 bytes so it is stored in the string
-      // table. In this case instead of name, an offset of the string in the
-      // string table is provided.
-
-      uint32_t strOffset = strTableOffset + SYMBOL_NAME_OFFSET(sym.name);
-      uint8_t ch;
-      for (;;) {
-        if (!readByte(p->fileBuffer, strOffset, ch)) {
-          PE_ERR(PEERR_MAGIC);
-          return false;
-        }
-        if (ch == 0u) {
-          break;
-        }
-        sym.strName.push_back((char) ch);
-        strOffset += sizeof(uint8_t);
-      }
-    } else {
-      for (uint8_t n = 0; n < NT_SHORT_NAME_LEN; n++) {
-        sym.strName.push_back((char) (sym.name.shortName[n]));
-      }
+    if (curEnt.NameRVA == 0 && curEnt.DelayImportNameTableRVA == 0 &&
+        curEnt.DelayImportAddressTableRVA == 0) {
+      break;
     }
 
-    offset += sizeof(uint64_t);
-
-    // Read value
-    if (!readDword(p->fileBuffer, offset, sym.value)) {
-      PE_ERR(PEERR_MAGIC);
-      return false;
-    }
+    const ptr base = (curEnt.Attributes & 1) != 0 ? imageBase : 0;
 
-    offset += sizeof(uint32_t);
+    VA name = static_cast<ptr>(curEnt.NameRVA + base);
 
-    // Read section number
-    uint16_t secNum;
-    if (!readWord(p->fileBuffer, offset, secNum)) {
-      PE_ERR(PEERR_MAGIC);
+    const section *nameSec;
+    if (!getSecForVA(p->internal->secIndex, name, nameSec)) {
       return false;
     }
-    sym.sectionNumber = (int16_t) secNum;
-
-    offset += sizeof(uint16_t);
 
-    // Read type
-    if (!readWord(p->fileBuffer, offset, sym.type)) {
-      PE_ERR(PEERR_MAGIC);
+    pe_string_view modName;
+    if (!readCString(p->internal->mem,
+                     nameSec->sectionData,
+                     name - nameSec->sectionBase,
+                     modName,
+                     true)) {
       return false;
     }
 
-    offset += sizeof(uint16_t);
-
-    // Read storage class
-    if (!readByte(p->fileBuffer, offset, sym.storageClass)) {
-      PE_ERR(PEERR_MAGIC);
+    if (curEnt.DelayImportNameTableRVA == 0 ||
+        !walkThunks<T>(p,
+                       modName,
+                       static_cast<ptr>(curEnt.DelayImportNameTableRVA + base),
+                       curEnt.DelayImportAddressTableRVA + base,
+                       base,
+                       p->internal->delayImports)) {
       return false;
     }
 
-    offset += sizeof(uint8_t);
+    offt += sizeof(delay_import_dir_entry);
+  } while (true);
 
-    // Read number of auxiliary symbols
-    if (!readByte(p->fileBuffer, offset, sym.numberOfAuxSymbols)) {
-      PE_ERR(PEERR_MAGIC);
+  return true;
+}
+
+/*
+ * Read the bound import directory. It lives in the headers and is located
+ * by file offset, and the module names are at offsets from its start, so it
+ * is read as a buffer of its own which nothing in it can point out of.
+ */
+template <class T>
+static bool getBoundImports(parsed_pe *p) {
+  const T &hdr = pe_format<T>::header(p);
+  data_directory boundDir = hdr.DataDirectory[DIR_BOUND_IMPORT];
+
+  if (boundDir.Size == 0) {
+    return true;
+  }
+
+  parsed_pe_internal *pint = p->internal;
+  bounded_buffer *b =
+      splitBufferInArena(pint->mem,
+                         p->fileBuffer,
+                         boundDir.VirtualAddress,
+                         static_cast<::uint64_t>(boundDir.VirtualAddress) +
+                             boundDir.Size);
+  if (b == nullptr) {
+    return false;
+  }
+
+  pint->boundImports.reserve(boundDir.Size /
+                             sizeof(bound_import_descriptor));
+
+  // the refs still to come for the current descriptor
+  ::uint32_t refs = 0;
+  for (::uint32_t off = 0; off < boundDir.Size;
+       off += sizeof(bound_import_descriptor)) {
+    bound_import_descriptor desc;
+    if (!readStruct(b, off, desc)) {
       return false;
     }
 
-    // Set offset to next symbol
-    offset += sizeof(uint8_t);
+    if (refs == 0 && desc.TimeDateStamp == 0 && desc.OffsetModuleName == 0 &&
+        desc.NumberOfModuleForwarderRefs == 0) {
+      break;
+    }
 
-    // Save the symbol
-    p->internal->symbols.push_back(sym);
+    boundimportent ent;
+    if (!readCString(pint->mem, b, desc.OffsetModuleName, ent.moduleName)) {
+      return false;
+    }
 
-    if (sym.numberOfAuxSymbols == 0) {
-      continue;
+    ent.timeDateStamp = desc.TimeDateStamp;
+    if (refs > 0) {
+      ent.forwarderRefs = 0;
+      ent.isForwarderRef = true;
+      refs--;
+    } else {
+      ent.forwarderRefs = desc.NumberOfModuleForwarderRefs;
+      ent.isForwarderRef = false;
+      refs = ent.forwarderRefs;
     }
 
-    // Read auxiliary symbol records
+    pint->boundImports.push_back(ent);
+  }
 
-    if (sym.storageClass == IMAGE_SYM_CLASS_EXTERNAL &&
-        SYMBOL_TYPE_HI(sym) == 0x20 && sym.sectionNumber > 0) {
-      // Auxiliary Format 1: Function Definitions
+  return true;
+}
 
-      for (uint8_t n = 0; n < sym.numberOfAuxSymbols; n++) {
-        aux_symbol_f1 asym;
+// read the slots of the IAT directory, as far as they are in the file
+template <class T>
+static bool getIAT(parsed_pe *p) {
+  typedef typename pe_format<T>::ptr ptr;
+  const T &hdr = pe_format<T>::header(p);
+  const ptr imageBase = hdr.ImageBase;
+  const ::uint32_t thunkSize = sizeof(ptr);
+  data_directory iatDir = hdr.DataDirectory[DIR_IAT];
 
-        // Read tag index
-        if (!readDword(p->fileBuffer, offset, asym.tagIndex)) {
-          PE_ERR(PEERR_MAGIC);
-          return false;
-        }
+  if (iatDir.Size == 0) {
+    return true;
+  }
 
-        offset += sizeof(uint32_t);
+  const section *s;
+  VA addr = static_cast<ptr>(iatDir.VirtualAddress + imageBase);
+  if (!getSecForVA(p->internal->secIndex, addr, s)) {
+    return false;
+  }
 
-        // Read total size
-        if (!readDword(p->fileBuffer, offset, asym.totalSize)) {
-          PE_ERR(PEERR_MAGIC);
-          return false;
-        }
+  ::uint64_t off = addr - s->sectionBase;
+  ::uint32_t count =
+      std::min(iatDir.Size, bytesAvailable(s->sectionData, off)) / thunkSize;
 
-        offset += sizeof(uint32_t);
+  arena_vector<iatent> &iat = p->internal->iat;
+  iat.resize(count);
+  for (::uint32_t i = 0; i < count; i++) {
+    ptr val;
+    if (!pe_format<T>::readPtr(s->sectionData, off + i * thunkSize, val)) {
+      return false;
+    }
 
-        // Read pointer to line number
-        if (!readDword(p->fileBuffer, offset, asym.pointerToLineNumber)) {
-          PE_ERR(PEERR_MAGIC);
-          return false;
-        }
+    iat[i].addr = addr + i * thunkSize;
+    iat[i].value = val;
+  }
 
-        offset += sizeof(uint32_t);
+  return true;
+}
 
-        // Read pointer to next function
-        if (!readDword(p->fileBuffer, offset, asym.pointerToNextFunction)) {
-          PE_ERR(PEERR_MAGIC);
-          return false;
-        }
+static bool beginsBefore(const runtime_function &a,
+                         const runtime_function &b) {
+  return a.BeginAddress < b.BeginAddress;
+}
 
-        // Skip the processed 4 bytes + unused 2 bytes
-        offset += sizeof(uint8_t) * 6;
+/*
+ * Turn an ARM or ARM64 function table, which only has each function's
+ * start and unwind word, into runtime_function records. The length is in
+ * the unwind word when it is packed, which its low two bits say, and in
+ * the first word of the .xdata record otherwise. It counts instructions,
+ * which are unit bytes long.
+ */
+template <class T>
+static bool readArmFunctions(parsed_pe *p,
+                             const section *s,
+                             ::uint64_t off,
+                             ::uint32_t count,
+                             ::uint32_t unit) {
+  typedef typename pe_format<T>::ptr ptr;
+  const ptr imageBase = pe_format<T>::header(p).ImageBase;
+  arena_vector<runtime_function> &fns = p->internal->functionCopy;
+
+  // .xdata records are usually all in one section, so keep the last one
+  const section *xdataSec = nullptr;
+
+  fns.resize(count);
+  for (::uint32_t i = 0; i < count; i++) {
+    ::uint32_t begin;
+    ::uint32_t unwind;
+    if (!readDword(s->sectionData, off + i * 8, begin) ||
+        !readDword(s->sectionData, off + i * 8 + 4, unwind)) {
+      return false;
+    }
 
-        // Save the record
-        sym.aux_symbols_f1.push_back(asym);
+    ::uint32_t len = 0;
+    if ((unwind & 3) != 0) {
+      len = (unwind >> 2) & 0x7FF;
+    } else {
+      VA xdata = static_cast<ptr>(unwind + imageBase);
+      if (xdataSec == nullptr || xdata < xdataSec->sectionBase ||
+          xdata - xdataSec->sectionBase >= xdataSec->sec.Misc.VirtualSize) {
+        if (!getSecForVA(p->internal->secIndex, xdata, xdataSec)) {
+          xdataSec = nullptr;
+        }
       }
-    } else if (sym.storageClass == IMAGE_SYM_CLASS_FUNCTION) {
-      // Auxiliary Format 2: .bf and .ef Symbols
 
-      for (uint8_t n = 0; n < sym.numberOfAuxSymbols; n++) {
-        aux_symbol_f2 asym;
-        // Skip unused 4 bytes
-        offset += sizeof(uint32_t);
+      // a record that can't be read leaves the function without a length
+      ::uint32_t word;
+      if (xdataSec != nullptr &&
+          readDword(
+              xdataSec->sectionData, xdata - xdataSec->sectionBase, word)) {
+        len = word & 0x3FFFF;
+      }
+    }
+
+    // Thumb code addresses have the low bit set
+    if (unit == 2) {
+      begin &= ~1U;
+    }
+
+    fns[i].BeginAddress = begin;
+    fns[i].EndAddress = begin + len * unit;
+    fns[i].UnwindInfoAddress = unwind;
+  }
+
+  return true;
+}
+
+/*
+ * Read the function table of the exception directory. x64 and Itanium
+ * tables already are runtime_function records, so as long as one is sorted
+ * and can be used where it is mapped, the view points straight into the
+ * section data. Anything else is decoded into functionCopy and sorted.
+ */
+template <class T>
+static bool getFunctionTable(parsed_pe *p) {
+  typedef typename pe_format<T>::ptr ptr;
+  const T &hdr = pe_format<T>::header(p);
+  const ptr imageBase = hdr.ImageBase;
+  data_directory exceptionDir = hdr.DataDirectory[DIR_EXCEPTION];
+  parsed_pe_internal *pint = p->internal;
+
+  if (exceptionDir.Size == 0) {
+    return true;
+  }
+
+  ::uint16_t machine = p->peHeader.nt.FileHeader.Machine;
+  ::uint32_t recordSize;
+  if (machine == IMAGE_FILE_MACHINE_AMD64 ||
+      machine == IMAGE_FILE_MACHINE_IA64) {
+    recordSize = sizeof(runtime_function);
+  } else if (machine == IMAGE_FILE_MACHINE_ARM64 ||
+             machine == IMAGE_FILE_MACHINE_ARMNT) {
+    recordSize = 8;
+  } else {
+    // other machines have their own layouts, if any
+    return true;
+  }
+
+  const section *s;
+  VA addr = static_cast<ptr>(exceptionDir.VirtualAddress + imageBase);
+  if (!getSecForVA(pint->secIndex, addr, s)) {
+    return false;
+  }
+
+  ::uint64_t off = addr - s->sectionBase;
+  ::uint32_t count =
+      std::min(exceptionDir.Size, bytesAvailable(s->sectionData, off)) /
+      recordSize;
+  if (count == 0) {
+    return true;
+  }
+
+  arena_vector<runtime_function> &fns = pint->functionCopy;
+  if (recordSize == sizeof(runtime_function)) {
+    const ::uint8_t *raw = s->sectionData->buf + off;
+    const runtime_function *first =
+        reinterpret_cast<const runtime_function *>(raw);
+
+    if (!s->sectionData->swapBytes &&
+        reinterpret_cast<std::uintptr_t>(raw) % alignof(runtime_function) ==
+            0 &&
+        std::is_sorted(first, first + count, beginsBefore)) {
+      pint->functions = pe_view<runtime_function>(first, first + count);
+      return true;
+    }
+
+    fns.resize(count);
+    if (!readStructs(s->sectionData, off, fns.data(), count)) {
+      return false;
+    }
+  } else {
+    ::uint32_t unit = machine == IMAGE_FILE_MACHINE_ARM64 ? 4 : 2;
+    if (!readArmFunctions<T>(p, s, off, count, unit)) {
+      return false;
+    }
+  }
+
+  if (!std::is_sorted(fns.begin(), fns.end(), beginsBefore)) {
+    std::stable_sort(fns.begin(), fns.end(), beginsBefore);
+  }
+
+  pint->functions = pe_view<runtime_function>(fns.data(), fns.data() + count);
+  return true;
+}
+
+/*
+ * Read the TLS directory and its callbacks. The callback array is a NUL
+ * terminated list of VAs, which is read from the one section it starts in.
+ * A list that runs off the end of that section's data is cut short there.
+ */
+template <class T>
+static bool getTLS(parsed_pe *p) {
+  typedef typename pe_format<T>::ptr ptr;
+  typedef typename pe_format<T>::tls_dir tls_dir;
+  const T &hdr = pe_format<T>::header(p);
+  const ptr imageBase = hdr.ImageBase;
+  data_directory tlsDir = hdr.DataDirectory[DIR_TLS];
+  parsed_pe_internal *pint = p->internal;
+
+  if (tlsDir.Size == 0) {
+    return true;
+  }
+
+  const section *s;
+  VA addr = static_cast<ptr>(tlsDir.VirtualAddress + imageBase);
+  if (!getSecForVA(pint->secIndex, addr, s)) {
+    return false;
+  }
+
+  tls_dir raw;
+  if (!readStruct(s->sectionData, addr - s->sectionBase, raw)) {
+    return false;
+  }
+
+  pint->tls.startAddressOfRawData = raw.StartAddressOfRawData;
+  pint->tls.endAddressOfRawData = raw.EndAddressOfRawData;
+  pint->tls.addressOfIndex = raw.AddressOfIndex;
+  pint->tls.addressOfCallBacks = raw.AddressOfCallBacks;
+  pint->tls.sizeOfZeroFill = raw.SizeOfZeroFill;
+  pint->tls.characteristics = raw.Characteristics;
+  pint->hasTLS = true;
+
+  const section *cbSec;
+  if (raw.AddressOfCallBacks == 0 ||
+      !getSecForVA(pint->secIndex, raw.AddressOfCallBacks, cbSec)) {
+    return true;
+  }
+
+  // the list ends at a null pointer or, failing that, the end of the
+  // section, and is found with one pass over the bytes
+  ::uint64_t off = raw.AddressOfCallBacks - cbSec->sectionBase;
+  ::uint32_t avail = bytesAvailable(cbSec->sectionData, off) / sizeof(ptr);
+  const ::uint8_t *b = cbSec->sectionData->buf + off;
+  ::uint32_t count = 0;
+  for (; count < avail; count++) {
+    ptr cb;
+    memcpy(&cb, b + count * sizeof(ptr), sizeof(cb));
+    if (cb == 0) {
+      break;
+    }
+  }
+
+  if (count == 0) {
+    return true;
+  }
+
+  // read them all at once into the start of the list, then widen PE32
+  // pointers in place from the back, where they don't overlap yet
+  pint->tlsCallbacks.resize(count);
+  VA *cbs = pint->tlsCallbacks.data();
+  if (!readFields(cbSec->sectionData,
+                  off,
+                  cbs,
+                  count * static_cast<::uint32_t>(sizeof(ptr)),
+                  sizeof(ptr),
+                  pe_format<T>::ptrFields)) {
+    pint->tlsCallbacks.clear();
+    return true;
+  }
+
+  if (sizeof(ptr) < sizeof(VA)) {
+    const ::uint8_t *in = reinterpret_cast<const ::uint8_t *>(cbs);
+    for (::uint32_t i = count; i-- > 0;) {
+      ptr cb;
+      memcpy(&cb, in + i * sizeof(ptr), sizeof(cb));
+      cbs[i] = cb;
+    }
+  }
+
+  return true;
+}
+
+// find the debug directory's entries, count is 0 when there are none
+template <class T>
+static bool findDebugDir(parsed_pe *p,
+                         const section *&s,
+                         ::uint64_t &off,
+                         ::uint32_t &count) {
+  typedef typename pe_format<T>::ptr ptr;
+  const T &hdr = pe_format<T>::header(p);
+  data_directory debugDir = hdr.DataDirectory[DIR_DEBUG];
+
+  count = 0;
+  if (debugDir.Size == 0) {
+    return true;
+  }
+
+  VA addr = static_cast<ptr>(debugDir.VirtualAddress + hdr.ImageBase);
+  if (!getSecForVA(p->internal->secIndex, addr, s)) {
+    return false;
+  }
+
+  off = addr - s->sectionBase;
+  count = std::min(debugDir.Size, bytesAvailable(s->sectionData, off)) /
+          sizeof(debug_dir_entry);
+  return true;
+}
+
+template <class T>
+static bool getDebugEntries(parsed_pe *p) {
+  const section *s;
+  ::uint64_t off;
+  ::uint32_t count;
+  if (!findDebugDir<T>(p, s, off, count)) {
+    return false;
+  }
+
+  arena_vector<debug_dir_entry> &entries = p->internal->debugEntries;
+  entries.resize(count);
+  return count == 0 ||
+         readStructs(s->sectionData, off, entries.data(), count);
+}
+
+/*
+ * Decode the CodeView record a debug directory entry points at. The record
+ * is read through a bounded_buffer on the stack covering just its bytes,
+ * so the path can't run past it and nothing is allocated.
+ */
+static bool readCodeView(parsed_pe *p,
+                         const debug_dir_entry &ent,
+                         pdb_info &info) {
+  bounded_buffer *file = p->fileBuffer;
+  if (ent.PointerToRawData == 0 || ent.PointerToRawData > file->bufLen ||
+      ent.SizeOfData > file->bufLen - ent.PointerToRawData) {
+    return false;
+  }
+
+  bounded_buffer rec = *file;
+  rec.buf = file->buf + ent.PointerToRawData;
+  rec.bufLen = ent.SizeOfData;
+  rec.copy = true;
+  rec.detail = nullptr;
+
+  ::uint32_t pathOff;
+  memset(&info.pdbGuid, 0, sizeof(info.pdbGuid));
+  if (!readDword(&rec, 0, info.cvSignature)) {
+    return false;
+  }
+
+  if (info.cvSignature == CV_SIGNATURE_RSDS) {
+    if (rec.bufLen < 24 || !readDword(&rec, 4, info.pdbGuid.Data1) ||
+        !readWord(&rec, 8, info.pdbGuid.Data2) ||
+        !readWord(&rec, 10, info.pdbGuid.Data3)) {
+      return false;
+    }
+
+    memcpy(info.pdbGuid.Data4, rec.buf + 12, sizeof(info.pdbGuid.Data4));
+    if (!readDword(&rec, 20, info.age)) {
+      return false;
+    }
+    pathOff = 24;
+  } else if (info.cvSignature == CV_SIGNATURE_NB10) {
+    // the dword at 4 is an offset that is always 0 in an image
+    if (!readDword(&rec, 8, info.pdbGuid.Data1) ||
+        !readDword(&rec, 12, info.age)) {
+      return false;
+    }
+    pathOff = 16;
+  } else {
+    return false;
+  }
+
+  return readCString(p->internal->mem, &rec, pathOff, info.pdbPath);
+}
+
+template <class T>
+static bool getPDBInfo(parsed_pe *p, pdb_info &info) {
+  const section *s;
+  ::uint64_t off;
+  ::uint32_t count;
+  if (!findDebugDir<T>(p, s, off, count)) {
+    return false;
+  }
+
+  for (::uint32_t i = 0; i < count; i++) {
+    debug_dir_entry ent;
+    if (!readStruct(
+            s->sectionData, off + i * sizeof(debug_dir_entry), ent)) {
+      return false;
+    }
+
+    if (ent.Type == IMAGE_DEBUG_TYPE_CODEVIEW && readCodeView(p, ent, info)) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// widen a PE32 load config to the PE32+ layout. The two don't have their
+// fields in quite the same order, so this goes field by field
+static void widenLoadConfig(const load_config_32 &in, load_config_64 &out) {
+  out.Size = in.Size;
+  out.TimeDateStamp = in.TimeDateStamp;
+  out.MajorVersion = in.MajorVersion;
+  out.MinorVersion = in.MinorVersion;
+  out.GlobalFlagsClear = in.GlobalFlagsClear;
+  out.GlobalFlagsSet = in.GlobalFlagsSet;
+  out.CriticalSectionDefaultTimeout = in.CriticalSectionDefaultTimeout;
+  out.DeCommitFreeBlockThreshold = in.DeCommitFreeBlockThreshold;
+  out.DeCommitTotalFreeThreshold = in.DeCommitTotalFreeThreshold;
+  out.LockPrefixTable = in.LockPrefixTable;
+  out.MaximumAllocationSize = in.MaximumAllocationSize;
+  out.VirtualMemoryThreshold = in.VirtualMemoryThreshold;
+  out.ProcessHeapFlags = in.ProcessHeapFlags;
+  out.ProcessAffinityMask = in.ProcessAffinityMask;
+  out.CSDVersion = in.CSDVersion;
+  out.DependentLoadFlags = in.DependentLoadFlags;
+  out.EditList = in.EditList;
+  out.SecurityCookie = in.SecurityCookie;
+  out.SEHandlerTable = in.SEHandlerTable;
+  out.SEHandlerCount = in.SEHandlerCount;
+  out.GuardCFCheckFunctionPointer = in.GuardCFCheckFunctionPointer;
+  out.GuardCFDispatchFunctionPointer = in.GuardCFDispatchFunctionPointer;
+  out.GuardCFFunctionTable = in.GuardCFFunctionTable;
+  out.GuardCFFunctionCount = in.GuardCFFunctionCount;
+  out.GuardFlags = in.GuardFlags;
+  out.CodeIntegrity = in.CodeIntegrity;
+  out.GuardAddressTakenIatEntryTable = in.GuardAddressTakenIatEntryTable;
+  out.GuardAddressTakenIatEntryCount = in.GuardAddressTakenIatEntryCount;
+  out.GuardLongJumpTargetTable = in.GuardLongJumpTargetTable;
+  out.GuardLongJumpTargetCount = in.GuardLongJumpTargetCount;
+  out.DynamicValueRelocTable = in.DynamicValueRelocTable;
+  out.CHPEMetadataPointer = in.CHPEMetadataPointer;
+  out.GuardRFFailureRoutine = in.GuardRFFailureRoutine;
+  out.GuardRFFailureRoutineFunctionPointer =
+      in.GuardRFFailureRoutineFunctionPointer;
+  out.DynamicValueRelocTableOffset = in.DynamicValueRelocTableOffset;
+  out.DynamicValueRelocTableSection = in.DynamicValueRelocTableSection;
+  out.Reserved2 = in.Reserved2;
+  out.GuardRFVerifyStackPointerFunctionPointer =
+      in.GuardRFVerifyStackPointerFunctionPointer;
+  out.HotPatchTableOffset = in.HotPatchTableOffset;
+  out.Reserved3 = in.Reserved3;
+  out.EnclaveConfigurationPointer = in.EnclaveConfigurationPointer;
+  out.VolatileMetadataPointer = in.VolatileMetadataPointer;
+  out.GuardEHContinuationTable = in.GuardEHContinuationTable;
+  out.GuardEHContinuationCount = in.GuardEHContinuationCount;
+  out.GuardXFGCheckFunctionPointer = in.GuardXFGCheckFunctionPointer;
+  out.GuardXFGDispatchFunctionPointer = in.GuardXFGDispatchFunctionPointer;
+  out.GuardXFGTableDispatchFunctionPointer =
+      in.GuardXFGTableDispatchFunctionPointer;
+  out.CastGuardOsDeterminedFailureMode = in.CastGuardOsDeterminedFailureMode;
+  out.GuardMemcpyFunctionPointer = in.GuardMemcpyFunctionPointer;
+}
+
+static void widenLoadConfig(const load_config_64 &in, load_config_64 &out) {
+  out = in;
+}
+
+/*
+ * Read the load config directory. How much of it there is comes from its
+ * own Size field rather than the data directory, which old linkers filled
+ * in with a fixed value. Fields past Size, or past the end of the section
+ * data, are left zero.
+ */
+template <class T>
+static bool getLoadConfig(parsed_pe *p) {
+  typedef typename pe_format<T>::ptr ptr;
+  typedef typename pe_format<T>::load_config load_config;
+  const T &hdr = pe_format<T>::header(p);
+  data_directory lcDir = hdr.DataDirectory[DIR_LOAD_CONFIG];
+  parsed_pe_internal *pint = p->internal;
+
+  if (lcDir.Size == 0) {
+    return true;
+  }
+
+  const section *s;
+  VA addr = static_cast<ptr>(lcDir.VirtualAddress + hdr.ImageBase);
+  if (!getSecForVA(pint->secIndex, addr, s)) {
+    return false;
+  }
+
+  ::uint64_t off = addr - s->sectionBase;
+  ::uint32_t size;
+  if (!readDword(s->sectionData, off, size)) {
+    return false;
+  }
+
+  ::uint32_t len = std::min(size, bytesAvailable(s->sectionData, off));
+  len = std::min(len, static_cast<::uint32_t>(sizeof(load_config)));
+
+  load_config raw;
+  memset(&raw, 0, sizeof(raw));
+  if (!readStruct(s->sectionData, off, raw, len)) {
+    return false;
+  }
+
+  widenLoadConfig(raw, pint->loadConfig);
+  pint->hasLoadConfig = true;
+  return true;
+}
+
+/*
+ * Read the attribute certificate table. It isn't mapped with the image, so
+ * its data directory entry holds a file offset rather than an RVA. Entries
+ * are padded out to 8 bytes.
+ */
+template <class T>
+static bool getCertificates(parsed_pe *p) {
+  const T &hdr = pe_format<T>::header(p);
+  data_directory certDir = hdr.DataDirectory[DIR_SECURITY];
+  bounded_buffer *file = p->fileBuffer;
+
+  if (certDir.Size == 0) {
+    return true;
+  }
+
+  if (certDir.VirtualAddress > file->bufLen ||
+      certDir.Size > file->bufLen - certDir.VirtualAddress) {
+    return false;
+  }
+
+  ::uint64_t off = certDir.VirtualAddress;
+  ::uint64_t end = off + certDir.Size;
+  while (end - off >= 8) {
+    ::uint32_t len;
+    certificate c;
+    if (!readDword(file, off, len) || !readWord(file, off + 4, c.revision) ||
+        !readWord(file, off + 6, c.type)) {
+      return false;
+    }
+
+    if (len < 8 || len > end - off) {
+      return false;
+    }
+
+    c.data = pe_view<::uint8_t>(file->buf + off + 8, file->buf + off + len);
+    p->internal->certificates.push_back(c);
+
+    // the padding of the last entry may be missing
+    off += std::min<::uint64_t>((len + 7ULL) & ~7ULL, end - off);
+  }
+
+  return true;
+}
+
+/*
+ * Read the CLR header and the metadata root and stream headers it points
+ * at. The metadata is read through a bounded_buffer on the stack covering
+ * just its bytes, so nothing in it can reach outside of it, and the
+ * streams are left in place as views.
+ */
+template <class T>
+static bool getCLR(parsed_pe *p) {
+  typedef typename pe_format<T>::ptr ptr;
+  const T &hdr = pe_format<T>::header(p);
+  data_directory clrDir = hdr.DataDirectory[DIR_COM_DESCRIPTOR];
+  parsed_pe_internal *pint = p->internal;
+
+  if (clrDir.Size == 0) {
+    return true;
+  }
+
+  const section *s;
+  VA addr = static_cast<ptr>(clrDir.VirtualAddress + hdr.ImageBase);
+  if (!getSecForVA(pint->secIndex, addr, s) ||
+      !readStruct(s->sectionData, addr - s->sectionBase, pint->clr)) {
+    return false;
+  }
+  pint->hasCLR = true;
+
+  data_directory mdDir = pint->clr.MetaData;
+  if (mdDir.Size == 0) {
+    return true;
+  }
+
+  addr = static_cast<ptr>(mdDir.VirtualAddress + hdr.ImageBase);
+  if (!getSecForVA(pint->secIndex, addr, s) || s->sectionData == nullptr) {
+    return false;
+  }
+
+  ::uint64_t off = addr - s->sectionBase;
+  bounded_buffer md = *s->sectionData;
+  md.bufLen = std::min(mdDir.Size, bytesAvailable(s->sectionData, off));
+  md.buf = s->sectionData->buf + off;
+  md.copy = true;
+  md.detail = nullptr;
+
+  clr_metadata &root = pint->clrMetadata;
+  ::uint32_t signature;
+  ::uint32_t versionLen;
+  if (!readDword(&md, 0, signature) || signature != CLR_METADATA_SIGNATURE ||
+      !readWord(&md, 4, root.majorVersion) ||
+      !readWord(&md, 6, root.minorVersion) ||
+      !readDword(&md, 12, versionLen) || versionLen > md.bufLen - 16) {
+    return false;
+  }
+
+  // the version is padded out to 4 bytes with NULs
+  const ::uint8_t *v = md.buf + 16;
+  root.version = pe_string_view(reinterpret_cast<const char *>(v),
+                                findNul(v, v + versionLen) - v);
+
+  ::uint64_t pos = 16 + ((versionLen + 3ULL) & ~3ULL);
+  ::uint16_t streams;
+  if (!readWord(&md, pos, root.flags) || !readWord(&md, pos + 2, streams)) {
+    return false;
+  }
+  root.data = pe_view<::uint8_t>(md.buf, md.buf + md.bufLen);
+  pos += 4;
+
+  for (::uint16_t i = 0; i < streams; i++) {
+    clr_stream st;
+    ::uint32_t size;
+    if (!readDword(&md, pos, st.offset) || !readDword(&md, pos + 4, size) ||
+        !readCString(pint->mem, &md, pos + 8, st.name)) {
+      return false;
+    }
+
+    // the name is padded out to 4 bytes with NULs, counting its own
+    pos += 8 + ((st.name.size() + 4) & ~3ULL);
+
+    const ::uint8_t *b = md.buf + std::min<::uint64_t>(st.offset, md.bufLen);
+    const ::uint8_t *e = md.buf + md.bufLen;
+    st.data = pe_view<::uint8_t>(b, b + std::min<::uint64_t>(size, e - b));
+    pint->clrStreams.push_back(st);
+  }
+
+  pint->hasCLRMetadata = true;
+  return true;
+}
+
+bool getSymbolTable(parsed_pe *p) {
+  if (p->peHeader.nt.FileHeader.PointerToSymbolTable == 0) {
+    return true;
+  }
+
+  uint32_t strTableOffset =
+      p->peHeader.nt.FileHeader.PointerToSymbolTable +
+      (p->peHeader.nt.FileHeader.NumberOfSymbols * SYMTAB_RECORD_LEN);
+
+  uint32_t offset = p->peHeader.nt.FileHeader.PointerToSymbolTable;
+
+  p->internal->symbols.reserve(
+      std::min(p->peHeader.nt.FileHeader.NumberOfSymbols,
+               bytesAvailable(p->fileBuffer, offset) / SYMTAB_RECORD_LEN));
+
+  for (uint32_t i = 0; i < p->peHeader.nt.FileHeader.NumberOfSymbols; i++) {
+    symbol sym;
+
+    // Read name
+    if (!readQword(p->fileBuffer, offset, sym.name.data)) {
+      PE_ERR(PEERR_MAGIC);
+      return false;
+    }
+
+    if (sym.name.zeroes == 0) {
+      // The symbol name is greater than 8 bytes so it is stored in the string
+      // table. In this case instead of name, an offset of the string in the
+      // string table is provided.
+
+      uint32_t strOffset = strTableOffset + SYMBOL_NAME_OFFSET(sym.name);
+      if (!readCString(
+              p->internal->mem, p->fileBuffer, strOffset, sym.strName)) {
+        PE_ERR(PEERR_MAGIC);
+        return false;
+      }
+    } else if (!readFixedString(
+                   p->fileBuffer, offset, NT_SHORT_NAME_LEN, sym.strName)) {
+      PE_ERR(PEERR_MAGIC);
+      return false;
+    }
+
+    offset += sizeof(uint64_t);
+
+    // Read value
+    if (!readDword(p->fileBuffer, offset, sym.value)) {
+      PE_ERR(PEERR_MAGIC);
+      return false;
+    }
+
+    offset += sizeof(uint32_t);
+
+    // Read section number
+    uint16_t secNum;
+    if (!readWord(p->fileBuffer, offset, secNum)) {
+      PE_ERR(PEERR_MAGIC);
+      return false;
+    }
+    sym.sectionNumber = (int16_t) secNum;
+
+    offset += sizeof(uint16_t);
+
+    // Read type
+    if (!readWord(p->fileBuffer, offset, sym.type)) {
+      PE_ERR(PEERR_MAGIC);
+      return false;
+    }
+
+    offset += sizeof(uint16_t);
+
+    // Read storage class
+    if (!readByte(p->fileBuffer, offset, sym.storageClass)) {
+      PE_ERR(PEERR_MAGIC);
+      return false;
+    }
+
+    offset += sizeof(uint8_t);
+
+    // Read number of auxiliary symbols
+    if (!readByte(p->fileBuffer, offset, sym.numberOfAuxSymbols)) {
+      PE_ERR(PEERR_MAGIC);
+      return false;
+    }
+
+    // Set offset to next symbol
+    offset += sizeof(uint8_t);
+
+    if (sym.numberOfAuxSymbols == 0) {
+      p->internal->symbols.push_back(sym);
+      continue;
+    }
+
+    // Read auxiliary symbol records
+
+    if (sym.storageClass == IMAGE_SYM_CLASS_EXTERNAL &&
+        SYMBOL_TYPE_HI(sym) == 0x20 && sym.sectionNumber > 0) {
+      // Auxiliary Format 1: Function Definitions
+
+      aux_symbol_f1 *aux = allocAuxRecords<aux_symbol_f1>(
+          p->internal->mem, sym.numberOfAuxSymbols);
+      if (aux == nullptr) {
+        PE_ERR(PEERR_MEM);
+        return false;
+      }
+
+      for (uint8_t n = 0; n < sym.numberOfAuxSymbols; n++) {
+        aux_symbol_f1 asym;
+
+        // Read tag index
+        if (!readDword(p->fileBuffer, offset, asym.tagIndex)) {
+          PE_ERR(PEERR_MAGIC);
+          return false;
+        }
+
+        offset += sizeof(uint32_t);
+
+        // Read total size
+        if (!readDword(p->fileBuffer, offset, asym.totalSize)) {
+          PE_ERR(PEERR_MAGIC);
+          return false;
+        }
+
+        offset += sizeof(uint32_t);
+
+        // Read pointer to line number
+        if (!readDword(p->fileBuffer, offset, asym.pointerToLineNumber)) {
+          PE_ERR(PEERR_MAGIC);
+          return false;
+        }
+
+        offset += sizeof(uint32_t);
+
+        // Read pointer to next function
+        if (!readDword(p->fileBuffer, offset, asym.pointerToNextFunction)) {
+          PE_ERR(PEERR_MAGIC);
+          return false;
+        }
+
+        // Skip the processed 4 bytes + unused 2 bytes
+        offset += sizeof(uint8_t) * 6;
+
+        // Save the record
+        aux[n] = asym;
+      }
+      sym.aux_symbols_f1 =
+          pe_view<aux_symbol_f1>(aux, aux + sym.numberOfAuxSymbols);
+    } else if (sym.storageClass == IMAGE_SYM_CLASS_FUNCTION) {
+      // Auxiliary Format 2: .bf and .ef Symbols
+
+      aux_symbol_f2 *aux = allocAuxRecords<aux_symbol_f2>(
+          p->internal->mem, sym.numberOfAuxSymbols);
+      if (aux == nullptr) {
+        PE_ERR(PEERR_MEM);
+        return false;
+      }
+
+      for (uint8_t n = 0; n < sym.numberOfAuxSymbols; n++) {
+        aux_symbol_f2 asym;
+        // Skip unused 4 bytes
+        offset += sizeof(uint32_t);
+
+        // Read line number
+        if (!readWord(p->fileBuffer, offset, asym.lineNumber)) {
+          PE_ERR(PEERR_MAGIC);
+          return false;
+        }
+
+        // Skip unused 6 bytes
+        offset += sizeof(uint8_t) * 6;
+
+        // Read pointer to next function
+        if (!readDword(p->fileBuffer, offset, asym.pointerToNextFunction)) {
+          PE_ERR(PEERR_MAGIC);
+          return false;
+        }
+
+        // Skip the processed 4 bytes + unused 2 bytes
+        offset += sizeof(uint8_t) * 6;
+
+        // Save the record
+        aux[n] = asym;
+      }
+      sym.aux_symbols_f2 =
+          pe_view<aux_symbol_f2>(aux, aux + sym.numberOfAuxSymbols);
+    } else if (sym.storageClass == IMAGE_SYM_CLASS_EXTERNAL &&
+               sym.sectionNumber == IMAGE_SYM_UNDEFINED && sym.value == 0) {
+      // Auxiliary Format 3: Weak Externals
+
+      aux_symbol_f3 *aux = allocAuxRecords<aux_symbol_f3>(
+          p->internal->mem, sym.numberOfAuxSymbols);
+      if (aux == nullptr) {
+        PE_ERR(PEERR_MEM);
+        return false;
+      }
+
+      for (uint8_t n = 0; n < sym.numberOfAuxSymbols; n++) {
+        aux_symbol_f3 asym;
+
+        // Read line number
+        if (!readDword(p->fileBuffer, offset, asym.tagIndex)) {
+          PE_ERR(PEERR_MAGIC);
+          return false;
+        }
+
+        // Read characteristics
+        if (!readDword(p->fileBuffer, offset, asym.characteristics)) {
+          PE_ERR(PEERR_MAGIC);
+          return false;
+        }
+
+        // Skip unused 10 bytes
+        offset += sizeof(uint8_t) * 10;
+
+        // Save the record
+        aux[n] = asym;
+      }
+      sym.aux_symbols_f3 =
+          pe_view<aux_symbol_f3>(aux, aux + sym.numberOfAuxSymbols);
+    } else if (sym.storageClass == IMAGE_SYM_CLASS_FILE) {
+      // Auxiliary Format 4: Files
+
+      aux_symbol_f4 *aux = allocAuxRecords<aux_symbol_f4>(
+          p->internal->mem, sym.numberOfAuxSymbols);
+      if (aux == nullptr) {
+        PE_ERR(PEERR_MEM);
+        return false;
+      }
+
+      for (uint8_t n = 0; n < sym.numberOfAuxSymbols; n++) {
+        aux_symbol_f4 asym;
+
+        // Read filename
+        if (!readFixedString(p->fileBuffer,
+                             offset,
+                             SYMTAB_RECORD_LEN,
+                             asym.strFilename)) {
+          PE_ERR(PEERR_MAGIC);
+          return false;
+        }
+
+        memcpy(asym.filename, asym.strFilename.data(), SYMTAB_RECORD_LEN);
+
+        // Save the record
+        aux[n] = asym;
+      }
+      sym.aux_symbols_f4 =
+          pe_view<aux_symbol_f4>(aux, aux + sym.numberOfAuxSymbols);
+    } else if (sym.storageClass == IMAGE_SYM_CLASS_STATIC) {
+      // Auxiliary Format 5: Section Definitions
+
+      aux_symbol_f5 *aux = allocAuxRecords<aux_symbol_f5>(
+          p->internal->mem, sym.numberOfAuxSymbols);
+      if (aux == nullptr) {
+        PE_ERR(PEERR_MEM);
+        return false;
+      }
+
+      for (uint8_t n = 0; n < sym.numberOfAuxSymbols; n++) {
+        aux_symbol_f5 asym;
+
+        // Read length
+        if (!readDword(p->fileBuffer, offset, asym.length)) {
+          PE_ERR(PEERR_MAGIC);
+          return false;
+        }
+
+        offset += sizeof(uint32_t);
+
+        // Read number of relocations
+        if (!readWord(p->fileBuffer, offset, asym.numberOfRelocations)) {
+          PE_ERR(PEERR_MAGIC);
+          return false;
+        }
+
+        offset += sizeof(uint16_t);
+
+        // Read number of line numbers
+        if (!readWord(p->fileBuffer, offset, asym.numberOfLineNumbers)) {
+          PE_ERR(PEERR_MAGIC);
+          return false;
+        }
+
+        offset += sizeof(uint16_t);
+
+        // Read checksum
+        if (!readDword(p->fileBuffer, offset, asym.checkSum)) {
+          PE_ERR(PEERR_MAGIC);
+          return false;
+        }
+
+        offset += sizeof(uint32_t);
+
+        // Read number
+        if (!readWord(p->fileBuffer, offset, asym.number)) {
+          PE_ERR(PEERR_MAGIC);
+          return false;
+        }
+
+        // Read selection
+        if (!readByte(p->fileBuffer, offset, asym.selection)) {
+          PE_ERR(PEERR_MAGIC);
+          return false;
+        }
+
+        // Skip unused 3 bytes
+        offset += sizeof(uint8_t) * 3;
+
+        // Save the record
+        aux[n] = asym;
+      }
+      sym.aux_symbols_f5 =
+          pe_view<aux_symbol_f5>(aux, aux + sym.numberOfAuxSymbols);
+    } else {
+      // Skip an unknown auxiliary record types
+      offset += sizeof(uint8_t) * SYMTAB_RECORD_LEN * sym.numberOfAuxSymbols;
+    }
+
+    // Save the symbol along with its records
+    p->internal->symbols.push_back(sym);
+  }
+
+  return true;
+}
+
+/*
+ * Read the directories in mask which haven't been read yet. Each one is
+ * tried only once, whether it parses or not.
+ */
+template <class T>
+static bool parseDirectories(parsed_pe *p, ::uint32_t mask) {
+  parsed_pe_internal *pint = p->internal;
+  ::uint32_t todo = mask & ~pint->parsed;
+
+  pint->parsed |= todo;
+
+  if (todo & PE_PARSE_RESOURCES) {
+    if (!getResources(
+            pint->mem, p->fileBuffer, p->fileBuffer, pint->secs, pint->rsrcs)) {
+      PE_ERR(PEERR_RESC);
+      return false;
+    }
+  }
+
+  // Get exports
+  if (todo & PE_PARSE_EXPORTS) {
+    if (!getExports<T>(p)) {
+      PE_ERR(PEERR_MAGIC);
+      return false;
+    }
+  }
+
+  // Get relocations, if exist
+  if (todo & PE_PARSE_RELOCATIONS) {
+    if (!getRelocations<T>(p)) {
+      PE_ERR(PEERR_MAGIC);
+      return false;
+    }
+  }
+
+  // Get imports
+  if (todo & PE_PARSE_IMPORTS) {
+    if (!getImports<T>(p)) {
+      return false;
+    }
+  }
+
+  // Get delay imports. They weren't always read, so a broken directory
+  // only loses the delay imports rather than failing the whole parse
+  if (todo & PE_PARSE_DELAY_IMPORTS) {
+    if (!getDelayImports<T>(p)) {
+      pint->delayImports.clear();
+    }
+  }
+
+  // Get the bound imports and the IAT, which weren't always read either
+  if (todo & PE_PARSE_BOUND_IMPORTS) {
+    if (!getBoundImports<T>(p)) {
+      pint->boundImports.clear();
+    }
+  }
+
+  if (todo & PE_PARSE_IAT) {
+    if (!getIAT<T>(p)) {
+      pint->iat.clear();
+    }
+  }
+
+  if (todo & PE_PARSE_EXCEPTIONS) {
+    if (!getFunctionTable<T>(p)) {
+      pint->functions = pe_view<runtime_function>();
+      pint->functionCopy.clear();
+    }
+  }
+
+  if (todo & PE_PARSE_DEBUG) {
+    if (!getDebugEntries<T>(p)) {
+      pint->debugEntries.clear();
+    }
+  }
+
+  if (todo & PE_PARSE_TLS) {
+    if (!getTLS<T>(p)) {
+      pint->hasTLS = false;
+      pint->tlsCallbacks.clear();
+    }
+  }
+
+  if (todo & PE_PARSE_LOAD_CONFIG) {
+    if (!getLoadConfig<T>(p)) {
+      pint->hasLoadConfig = false;
+    }
+  }
+
+  if (todo & PE_PARSE_CERTIFICATES) {
+    if (!getCertificates<T>(p)) {
+      pint->certificates.clear();
+    }
+  }
+
+  // a CLR header that was read is kept when its metadata is broken
+  if (todo & PE_PARSE_CLR) {
+    if (!getCLR<T>(p)) {
+      pint->hasCLRMetadata = false;
+      pint->clrStreams.clear();
+    }
+  }
+
+  // Get symbol table
+  if (todo & PE_PARSE_SYMBOLS) {
+    if (!getSymbolTable(p)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool parseDirectories(parsed_pe *p, ::uint32_t mask) {
+  // getHeader only accepts these two
+  if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
+    return parseDirectories<optional_header_32>(p, mask);
+  }
+
+  return parseDirectories<optional_header_64>(p, mask);
+}
+
+static void ensureExportsIndexed(parsed_pe *pe);
+
+// parse the headers and directories out of buffer, which is consumed
+static parsed_pe *parsePEFromBuffer(bounded_buffer *buffer,
+                                    ::uint32_t flags) {
+  // First, create a new parsed_pe structure
+  // We pass std::nothrow parameter to new so in case of failure it returns
+  // nullptr instead of throwing exception std::bad_alloc.
+  parsed_pe *p = new (std::nothrow) parsed_pe();
+
+  if (p == nullptr) {
+    deleteBuffer(buffer);
+    PE_ERR(PEERR_MEM);
+    return nullptr;
+  }
+
+  p->fileBuffer = buffer;
+  p->internal = new (std::nothrow) parsed_pe_internal();
+
+  if (p->internal == nullptr) {
+    deleteBuffer(p->fileBuffer);
+    delete p;
+    PE_ERR(PEERR_MEM);
+    return nullptr;
+  }
+
+  // get header information
+  bounded_buffer *remaining = nullptr;
+  if (!getHeader(p->fileBuffer, p->peHeader, remaining)) {
+    DestructParsedPE(p);
+    // err is set by getHeader
+    return nullptr;
+  }
+
+  // the containers throw when the arena can't grow, which fails the parse
+  // like any other lack of memory
+  try {
+    bounded_buffer *file = p->fileBuffer;
+    if (!getSections(p->internal->mem,
+                     remaining,
+                     file,
+                     p->peHeader.nt,
+                     p->internal->secs,
+                     p->internal->secIndex)) {
+      deleteBuffer(remaining);
+      DestructParsedPE(p);
+      PE_ERR(PEERR_SECT);
+      return nullptr;
+    }
+
+    deleteBuffer(remaining);
+    remaining = nullptr;
+
+    p->internal->flags = flags;
+    if ((flags & PE_PARSE_LAZY) == 0 &&
+        !parseDirectories(p, flags & PE_PARSE_ALL)) {
+      DestructParsedPE(p);
+      return nullptr;
+    }
+
+    // with the lookup tables built now, lookups only ever read the parsed_pe
+    if ((flags & (PE_PARSE_LAZY | PE_PARSE_EXPORTS)) == PE_PARSE_EXPORTS) {
+      ensureExportsIndexed(p);
+    }
+  } catch (const std::bad_alloc &) {
+    deleteBuffer(remaining);
+    DestructParsedPE(p);
+    PE_ERR(PEERR_MEM);
+    return nullptr;
+  }
+
+  return p;
+}
+
+parsed_pe *ParsePEFromFile(const char *filePath, ::uint32_t flags) {
+  clearPEErr();
+
+  // Make a new buffer object to hold just our file data
+  bounded_buffer *buffer = readFileToFileBuffer(filePath);
+
+  if (buffer == nullptr) {
+    // err is set by readFileToFileBuffer
+    return nullptr;
+  }
+
+  return parsePEFromBuffer(buffer, flags);
+}
+
+parsed_pe *ParsePEFromBuffer(const ::uint8_t *buffer,
+                             std::size_t sz,
+                             ::uint32_t flags) {
+  clearPEErr();
+
+  // the buffer is never written to, it only borrows the callers memory
+  bounded_buffer *b =
+      makeBufferFromPointer(const_cast<::uint8_t *>(buffer), sz);
+
+  if (b == nullptr) {
+    // err is set by makeBufferFromPointer
+    return nullptr;
+  }
+
+  return parsePEFromBuffer(b, flags);
+}
+
+parsed_pe *
+ParsePEFromFile(const char *filePath, pe_error &err, ::uint32_t flags) {
+  parsed_pe *p = ParsePEFromFile(filePath, flags);
+  err = lastErr;
+  return p;
+}
+
+parsed_pe *ParsePEFromBuffer(const ::uint8_t *buffer,
+                             std::size_t sz,
+                             pe_error &err,
+                             ::uint32_t flags) {
+  parsed_pe *p = ParsePEFromBuffer(buffer, sz, flags);
+  err = lastErr;
+  return p;
+}
+
+void DestructParsedPE(parsed_pe *p) {
+  if (p == nullptr) {
+    return;
+  }
+
+  deleteBuffer(p->fileBuffer);
+
+  // the section and resource buffers live in the arena, which goes with this
+  delete p->internal;
+  delete p;
+  return;
+}
+
+pe_view<importent> GetImports(parsed_pe *pe) {
+  arena_vector<importent> &l = pe->internal->imports;
+
+  ensureParsed(pe, PE_PARSE_IMPORTS, l);
+
+  return pe_view<importent>(l.data(), l.data() + l.size());
+}
+
+pe_view<importent> GetDelayImports(parsed_pe *pe) {
+  arena_vector<importent> &l = pe->internal->delayImports;
+
+  ensureParsed(pe, PE_PARSE_DELAY_IMPORTS, l);
+
+  return pe_view<importent>(l.data(), l.data() + l.size());
+}
+
+pe_view<boundimportent> GetBoundImports(parsed_pe *pe) {
+  arena_vector<boundimportent> &l = pe->internal->boundImports;
+
+  ensureParsed(pe, PE_PARSE_BOUND_IMPORTS, l);
+
+  return pe_view<boundimportent>(l.data(), l.data() + l.size());
+}
+
+pe_view<iatent> GetIAT(parsed_pe *pe) {
+  arena_vector<iatent> &l = pe->internal->iat;
+
+  ensureParsed(pe, PE_PARSE_IAT, l);
+
+  return pe_view<iatent>(l.data(), l.data() + l.size());
+}
+
+pe_view<runtime_function> GetFunctionTable(parsed_pe *pe) {
+  parsed_pe_internal *pint = pe->internal;
+
+  ensureParsed(pe, PE_PARSE_EXCEPTIONS, pint->functionCopy);
+
+  return pint->functions;
+}
+
+const runtime_function *FindFunctionForVA(parsed_pe *pe, VA v) {
+  pe_view<runtime_function> fns = GetFunctionTable(pe);
+
+  VA imageBase;
+  if (pe->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
+    imageBase = pe->peHeader.nt.OptionalHeader.ImageBase;
+  } else {
+    imageBase = pe->peHeader.nt.OptionalHeader64.ImageBase;
+  }
+
+  if (v < imageBase || v - imageBase > UINT32_MAX) {
+    return nullptr;
+  }
+
+  if (fns.empty()) {
+    return nullptr;
+  }
+
+  // find the last function starting at or before v. The halving is done
+  // without branching on the comparison, which a random address would
+  // mispredict half the time
+  ::uint32_t rva = static_cast<::uint32_t>(v - imageBase);
+  const runtime_function *f = fns.begin();
+  std::size_t n = fns.size();
+  while (n > 1) {
+    std::size_t half = n / 2;
+    f = f[half].BeginAddress <= rva ? f + half : f;
+    n -= half;
+  }
+
+  if (rva < f->BeginAddress || rva >= f->EndAddress) {
+    return nullptr;
+  }
+
+  return f;
+}
+
+pe_view<debug_dir_entry> GetDebugEntries(parsed_pe *pe) {
+  arena_vector<debug_dir_entry> &l = pe->internal->debugEntries;
+
+  ensureParsed(pe, PE_PARSE_DEBUG, l);
+
+  return pe_view<debug_dir_entry>(l.data(), l.data() + l.size());
+}
+
+bool GetPDBInfo(parsed_pe *pe, pdb_info &info) {
+  if (pe->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
+    return getPDBInfo<optional_header_32>(pe, info);
+  }
+
+  return getPDBInfo<optional_header_64>(pe, info);
+}
+
+bool GetTLSDirectory(parsed_pe *pe, tls_directory &tls) {
+  parsed_pe_internal *pint = pe->internal;
+
+  ensureParsed(pe, PE_PARSE_TLS, pint->tlsCallbacks);
+
+  if (!pint->hasTLS) {
+    return false;
+  }
+
+  tls = pint->tls;
+  return true;
+}
+
+pe_view<VA> GetTLSCallbacks(parsed_pe *pe) {
+  arena_vector<VA> &l = pe->internal->tlsCallbacks;
+
+  ensureParsed(pe, PE_PARSE_TLS, l);
+
+  return pe_view<VA>(l.data(), l.data() + l.size());
+}
+
+bool GetLoadConfig(parsed_pe *pe, load_config_64 &lc) {
+  parsed_pe_internal *pint = pe->internal;
+
+  if (!ensureParsed(pe, PE_PARSE_LOAD_CONFIG) || !pint->hasLoadConfig) {
+    return false;
+  }
+
+  lc = pint->loadConfig;
+  return true;
+}
+
+// view the count entries of stride bytes at v, cut short where the section
+// data ends
+static pe_rva_table
+getRvaTable(parsed_pe *pe, VA v, ::uint64_t count, ::uint32_t stride) {
+  const section *s;
+  if (v == 0 || count == 0 || !getSecForVA(pe->internal->secIndex, v, s)) {
+    return pe_rva_table();
+  }
+
+  ::uint64_t off = v - s->sectionBase;
+  ::uint64_t avail = bytesAvailable(s->sectionData, off) / stride;
+  if (avail == 0) {
+    return pe_rva_table();
+  }
+
+  return pe_rva_table(
+      s->sectionData->buf + off, std::min(count, avail), stride);
+}
+
+// the CFG tables all have GuardFlags' count of extra bytes after each RVA
+static pe_rva_table getGuardTable(parsed_pe *pe, VA v, ::uint64_t count) {
+  const load_config_64 &lc = pe->internal->loadConfig;
+  ::uint32_t sizeBits = lc.GuardFlags & IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_MASK;
+  ::uint32_t extra = sizeBits >> IMAGE_GUARD_CF_FUNCTION_TABLE_SIZE_SHIFT;
+  return getRvaTable(pe, v, count, 4 + extra);
+}
+
+pe_rva_table GetGuardCFFunctionTable(parsed_pe *pe) {
+  load_config_64 lc;
+  if (!GetLoadConfig(pe, lc)) {
+    return pe_rva_table();
+  }
+
+  return getGuardTable(pe, lc.GuardCFFunctionTable, lc.GuardCFFunctionCount);
+}
+
+pe_rva_table GetGuardAddressTakenIatTable(parsed_pe *pe) {
+  load_config_64 lc;
+  if (!GetLoadConfig(pe, lc)) {
+    return pe_rva_table();
+  }
+
+  return getGuardTable(pe,
+                       lc.GuardAddressTakenIatEntryTable,
+                       lc.GuardAddressTakenIatEntryCount);
+}
+
+pe_rva_table GetGuardLongJumpTargetTable(parsed_pe *pe) {
+  load_config_64 lc;
+  if (!GetLoadConfig(pe, lc)) {
+    return pe_rva_table();
+  }
+
+  return getGuardTable(
+      pe, lc.GuardLongJumpTargetTable, lc.GuardLongJumpTargetCount);
+}
+
+pe_rva_table GetGuardEHContinuationTable(parsed_pe *pe) {
+  load_config_64 lc;
+  if (!GetLoadConfig(pe, lc)) {
+    return pe_rva_table();
+  }
+
+  return getGuardTable(
+      pe, lc.GuardEHContinuationTable, lc.GuardEHContinuationCount);
+}
+
+pe_rva_table GetSEHandlerTable(parsed_pe *pe) {
+  load_config_64 lc;
+  if (!GetLoadConfig(pe, lc)) {
+    return pe_rva_table();
+  }
+
+  return getRvaTable(pe, lc.SEHandlerTable, lc.SEHandlerCount, 4);
+}
+
+bool GetCLRHeader(parsed_pe *pe, clr_header &clr) {
+  parsed_pe_internal *pint = pe->internal;
+
+  ensureParsed(pe, PE_PARSE_CLR, pint->clrStreams);
+
+  if (!pint->hasCLR) {
+    return false;
+  }
+
+  clr = pint->clr;
+  return true;
+}
+
+bool GetCLRMetadata(parsed_pe *pe, clr_metadata &md) {
+  parsed_pe_internal *pint = pe->internal;
+
+  ensureParsed(pe, PE_PARSE_CLR, pint->clrStreams);
+
+  if (!pint->hasCLRMetadata) {
+    return false;
+  }
+
+  md = pint->clrMetadata;
+  return true;
+}
+
+pe_view<clr_stream> GetCLRStreams(parsed_pe *pe) {
+  arena_vector<clr_stream> &l = pe->internal->clrStreams;
+
+  ensureParsed(pe, PE_PARSE_CLR, l);
+
+  return pe_view<clr_stream>(l.data(), l.data() + l.size());
+}
+
+const clr_stream *FindCLRStream(parsed_pe *pe, const char *name) {
+  pe_string_view n(name, strlen(name));
+
+  for (const clr_stream &s : GetCLRStreams(pe)) {
+    if (s.name == n) {
+      return &s;
+    }
+  }
+
+  return nullptr;
+}
+
+/*
+ * The resource tree as a bounded_buffer on the stack, running from its root
+ * to the end of the section data. The offsets in the tree are all from the
+ * root, so they can be read from it as they are.
+ */
+template <class T>
+static bool getResourceTree(parsed_pe *p, bounded_buffer &tree) {
+  typedef typename pe_format<T>::ptr ptr;
+  const T &hdr = pe_format<T>::header(p);
+  data_directory rsrcDir = hdr.DataDirectory[DIR_RESOURCE];
+
+  const section *s;
+  VA addr = static_cast<ptr>(rsrcDir.VirtualAddress + hdr.ImageBase);
+  if (rsrcDir.Size == 0 || !getSecForVA(p->internal->secIndex, addr, s) ||
+      s->sectionData == nullptr) {
+    return false;
+  }
+
+  ::uint64_t off = addr - s->sectionBase;
+  tree = *s->sectionData;
+  tree.bufLen = bytesAvailable(s->sectionData, off);
+  tree.buf = s->sectionData->buf + std::min(off, s->sectionData->bufLen);
+  tree.copy = true;
+  tree.detail = nullptr;
+  return true;
+}
+
+static bool getResourceTree(parsed_pe *p, bounded_buffer &tree) {
+  if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
+    return getResourceTree<optional_header_32>(p, tree);
+  }
+
+  return getResourceTree<optional_header_64>(p, tree);
+}
+
+// the bytes of a resource, which its data entry gives the RVA of
+template <class T>
+static bool getResourceBytes(parsed_pe *p,
+                             ::uint32_t rva,
+                             ::uint32_t size,
+                             pe_view<::uint8_t> &data) {
+  typedef typename pe_format<T>::ptr ptr;
+  const T &hdr = pe_format<T>::header(p);
+
+  const section *s;
+  VA addr = static_cast<ptr>(rva + hdr.ImageBase);
+  if (!getSecForVA(p->internal->secIndex, addr, s) ||
+      s->sectionData == nullptr) {
+    return false;
+  }
+
+  ::uint64_t off = addr - s->sectionBase;
+  ::uint32_t len = std::min(size, bytesAvailable(s->sectionData, off));
+  const ::uint8_t *b = s->sectionData->buf + (len != 0 ? off : 0);
+  data = pe_view<::uint8_t>(b, b + len);
+  return true;
+}
+
+static bool readResourceDir(bounded_buffer *tree,
+                            ::uint32_t off,
+                            resource_dir &dir) {
+  dir.offset = off;
+  return readWord(tree,
+                  off + _offset(resource_dir_table, NameEntries),
+                  dir.nameEntries) &&
+         readWord(
+             tree, off + _offset(resource_dir_table, IDEntries), dir.idEntries);
+}
+
+static bool readResourceNode(bounded_buffer *tree,
+                             const resource_dir &dir,
+                             ::uint32_t index,
+                             resource_node &node) {
+  if (index >= static_cast<::uint32_t>(dir.nameEntries) + dir.idEntries) {
+    return false;
+  }
+
+  ::uint64_t off = dir.offset + sizeof(resource_dir_table) +
+                   index * sizeof(resource_dir_entry_sz);
+  ::uint32_t id;
+  ::uint32_t target;
+  if (!readDword(tree, off, id) || !readDword(tree, off + 4, target)) {
+    return false;
+  }
+
+  // a named entry has the offset of a counted UTF-16 string in place of
+  // its ID, and the high bit of an entry's target marks a subdirectory
+  node.named = index < dir.nameEntries;
+  node.id = node.named ? 0 : id;
+  node.name = pe_string_view();
+  if (node.named) {
+    ::uint16_t len;
+    ::uint32_t nameOff = id & 0x7FFFFFFF;
+    if (!readWord(tree, nameOff, len) ||
+        !readFixedString(tree, nameOff + 2ULL, len * 2U, node.name)) {
+      return false;
+    }
+  }
+  node.isDir = (target & 0x80000000) != 0;
+  node.offset = target & 0x7FFFFFFF;
+  return true;
+}
+
+static bool openResourceDir(bounded_buffer *tree,
+                            const resource_node &node,
+                            resource_dir &dir) {
+  return node.isDir && readResourceDir(tree, node.offset, dir);
+}
+
+// the entries with an ID are sorted by it, which the loader relies on too
+static bool findResourceChild(bounded_buffer *tree,
+                              const resource_dir &dir,
+                              ::uint32_t id,
+                              resource_node &node) {
+  ::uint32_t lo = dir.nameEntries;
+  ::uint32_t hi = lo + dir.idEntries;
+
+  while (lo < hi) {
+    ::uint32_t mid = lo + (hi - lo) / 2;
+    if (!readResourceNode(tree, dir, mid, node)) {
+      return false;
+    }
+
+    if (node.id == id) {
+      return true;
+    } else if (node.id < id) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return false;
+}
+
+static bool findResourceChild(bounded_buffer *tree,
+                              const resource_dir &dir,
+                              const char *name,
+                              resource_node &node) {
+  std::size_t len = strlen(name);
+
+  for (::uint32_t i = 0; i < dir.nameEntries; i++) {
+    if (!readResourceNode(tree, dir, i, node)) {
+      return false;
+    }
+
+    if (node.name.size() != len * 2) {
+      continue;
+    }
+
+    const ::uint8_t *u = reinterpret_cast<const ::uint8_t *>(node.name.data());
+    std::size_t j = 0;
+    for (; j < len; j++) {
+      ::uint16_t c = static_cast<::uint16_t>(u[j * 2] | (u[j * 2 + 1] << 8));
+      ::uint8_t n = static_cast<::uint8_t>(name[j]);
+      if (c != n && (c > 0x7F || ::tolower(c) != ::tolower(n))) {
+        break;
+      }
+    }
+
+    if (j == len) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool readResourceData(parsed_pe *p,
+                             bounded_buffer *tree,
+                             const resource_node &node,
+                             resource_data &data) {
+  if (node.isDir ||
+      !readDword(tree,
+                 node.offset + _offset(resource_dat_entry, RVA),
+                 data.RVA) ||
+      !readDword(tree,
+                 node.offset + _offset(resource_dat_entry, size),
+                 data.size) ||
+      !readDword(tree,
+                 node.offset + _offset(resource_dat_entry, codepage),
+                 data.codepage)) {
+    return false;
+  }
+
+  if (p->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
+    return getResourceBytes<optional_header_32>(
+        p, data.RVA, data.size, data.data);
+  }
+
+  return getResourceBytes<optional_header_64>(
+      p, data.RVA, data.size, data.data);
+}
+
+bool GetResourceRoot(parsed_pe *pe, resource_dir &root) {
+  bounded_buffer tree;
+  return getResourceTree(pe, tree) && readResourceDir(&tree, 0, root);
+}
 
-        // Read line number
-        if (!readWord(p->fileBuffer, offset, asym.lineNumber)) {
-          PE_ERR(PEERR_MAGIC);
-          return false;
-        }
+bool GetResourceChild(parsed_pe *pe,
+                      const resource_dir &dir,
+                      ::uint32_t index,
+                      resource_node &node) {
+  bounded_buffer tree;
+  return getResourceTree(pe, tree) &&
+         readResourceNode(&tree, dir, index, node);
+}
 
-        // Skip unused 6 bytes
-        offset += sizeof(uint8_t) * 6;
+bool OpenResourceDir(parsed_pe *pe,
+                     const resource_node &node,
+                     resource_dir &dir) {
+  bounded_buffer tree;
+  return getResourceTree(pe, tree) && openResourceDir(&tree, node, dir);
+}
 
-        // Read pointer to next function
-        if (!readDword(p->fileBuffer, offset, asym.pointerToNextFunction)) {
-          PE_ERR(PEERR_MAGIC);
-          return false;
-        }
+bool GetResourceData(parsed_pe *pe,
+                     const resource_node &node,
+                     resource_data &data) {
+  bounded_buffer tree;
+  return getResourceTree(pe, tree) && readResourceData(pe, &tree, node, data);
+}
 
-        // Skip the processed 4 bytes + unused 2 bytes
-        offset += sizeof(uint8_t) * 6;
+bool FindResourceChild(parsed_pe *pe,
+                       const resource_dir &dir,
+                       ::uint32_t id,
+                       resource_node &node) {
+  bounded_buffer tree;
+  return getResourceTree(pe, tree) && findResourceChild(&tree, dir, id, node);
+}
 
-        // Save the record
-        sym.aux_symbols_f2.push_back(asym);
-      }
-    } else if (sym.storageClass == IMAGE_SYM_CLASS_EXTERNAL &&
-               sym.sectionNumber == IMAGE_SYM_UNDEFINED && sym.value == 0) {
-      // Auxiliary Format 3: Weak Externals
+bool FindResourceChild(parsed_pe *pe,
+                       const resource_dir &dir,
+                       const char *name,
+                       resource_node &node) {
+  bounded_buffer tree;
+  return getResourceTree(pe, tree) &&
+         findResourceChild(&tree, dir, name, node);
+}
 
-      for (uint8_t n = 0; n < sym.numberOfAuxSymbols; n++) {
-        aux_symbol_f3 asym;
+bool FindResourceData(parsed_pe *pe,
+                      ::uint32_t type,
+                      ::uint32_t name,
+                      ::uint32_t lang,
+                      resource_data &data) {
+  bounded_buffer tree;
+  resource_dir dir;
+  resource_node node;
+  if (!getResourceTree(pe, tree) || !readResourceDir(&tree, 0, dir) ||
+      !findResourceChild(&tree, dir, type, node) ||
+      !openResourceDir(&tree, node, dir) ||
+      !findResourceChild(&tree, dir, name, node) ||
+      !openResourceDir(&tree, node, dir)) {
+    return false;
+  }
 
-        // Read line number
-        if (!readDword(p->fileBuffer, offset, asym.tagIndex)) {
-          PE_ERR(PEERR_MAGIC);
-          return false;
-        }
+  if (lang == RESOURCE_ANY_LANG) {
+    if (!readResourceNode(&tree, dir, 0, node)) {
+      return false;
+    }
+  } else if (!findResourceChild(&tree, dir, lang, node)) {
+    return false;
+  }
 
-        // Read characteristics
-        if (!readDword(p->fileBuffer, offset, asym.characteristics)) {
-          PE_ERR(PEERR_MAGIC);
-          return false;
-        }
+  return readResourceData(pe, &tree, node, data);
+}
 
-        // Skip unused 10 bytes
-        offset += sizeof(uint8_t) * 10;
+pe_view<certificate> GetCertificates(parsed_pe *pe) {
+  arena_vector<certificate> &l = pe->internal->certificates;
 
-        // Save the record
-        sym.aux_symbols_f3.push_back(asym);
-      }
-    } else if (sym.storageClass == IMAGE_SYM_CLASS_FILE) {
-      // Auxiliary Format 4: Files
+  ensureParsed(pe, PE_PARSE_CERTIFICATES, l);
 
-      for (uint8_t n = 0; n < sym.numberOfAuxSymbols; n++) {
-        aux_symbol_f4 asym;
+  return pe_view<certificate>(l.data(), l.data() + l.size());
+}
 
-        // Read filename
-        for (uint16_t j = 0; j < SYMTAB_RECORD_LEN; j++) {
-          if (!readByte(p->fileBuffer, offset, asym.filename[j])) {
-            PE_ERR(PEERR_MAGIC);
-            return false;
-          }
-          asym.strFilename.push_back((char) asym.filename[j]);
-        }
+struct file_range {
+  ::uint64_t off;
+  ::uint64_t len;
+};
 
-        // Save the record
-        sym.aux_symbols_f4.push_back(asym);
-      }
-    } else if (sym.storageClass == IMAGE_SYM_CLASS_STATIC) {
-      // Auxiliary Format 5: Section Definitions
+// the file offset of the optional header
+static bool getOptionalHeaderOffset(parsed_pe *p, ::uint64_t &off) {
+  ::uint32_t ntOff;
+  if (!readDword(p->fileBuffer, _offset(dos_header, e_lfanew), ntOff)) {
+    return false;
+  }
 
-      for (uint8_t n = 0; n < sym.numberOfAuxSymbols; n++) {
-        aux_symbol_f5 asym;
+  off = static_cast<::uint64_t>(ntOff) + _offset(nt_header_32, OptionalHeader);
+  return true;
+}
 
-        // Read length
-        if (!readDword(p->fileBuffer, offset, asym.length)) {
-          PE_ERR(PEERR_MAGIC);
-          return false;
-        }
+/*
+ * Find the parts of the file Authenticode leaves out of the hash, in file
+ * order: the CheckSum field, the certificate table's data directory entry
+ * and the certificate table itself.
+ */
+template <class T>
+static bool getAuthenticodeHoles(parsed_pe *p,
+                                 file_range *holes,
+                                 std::size_t &count) {
+  const T &hdr = pe_format<T>::header(p);
+  bounded_buffer *file = p->fileBuffer;
 
-        offset += sizeof(uint32_t);
+  ::uint64_t optOff;
+  if (!getOptionalHeaderOffset(p, optOff)) {
+    return false;
+  }
 
-        // Read number of relocations
-        if (!readWord(p->fileBuffer, offset, asym.numberOfRelocations)) {
-          PE_ERR(PEERR_MAGIC);
-          return false;
-        }
+  count = 0;
+  holes[count].off = optOff + _offset(T, CheckSum);
+  holes[count++].len = sizeof(hdr.CheckSum);
 
-        offset += sizeof(uint16_t);
+  if (hdr.NumberOfRvaAndSizes > DIR_SECURITY) {
+    holes[count].off = optOff + _offset(T, DataDirectory[DIR_SECURITY]);
+    holes[count++].len = sizeof(data_directory);
 
-        // Read number of line numbers
-        if (!readWord(p->fileBuffer, offset, asym.numberOfLineNumbers)) {
-          PE_ERR(PEERR_MAGIC);
-          return false;
-        }
+    data_directory certDir = hdr.DataDirectory[DIR_SECURITY];
+    if (certDir.Size != 0) {
+      holes[count].off = certDir.VirtualAddress;
+      holes[count++].len = certDir.Size;
+    }
+  }
 
-        offset += sizeof(uint16_t);
+  // the holes have to be in order and inside the file
+  ::uint64_t pos = 0;
+  for (std::size_t i = 0; i < count; i++) {
+    if (holes[i].off < pos || holes[i].off > file->bufLen ||
+        holes[i].len > file->bufLen - holes[i].off) {
+      return false;
+    }
+    pos = holes[i].off + holes[i].len;
+  }
 
-        // Read checksum
-        if (!readDword(p->fileBuffer, offset, asym.checkSum)) {
-          PE_ERR(PEERR_MAGIC);
-          return false;
-        }
+  return true;
+}
 
-        offset += sizeof(uint32_t);
+// hash the file around the holes, a contiguous run at a time
+template <class H>
+static void digestAround(bounded_buffer *file,
+                         const file_range *holes,
+                         std::size_t count,
+                         ::uint8_t *out) {
+  H h;
+  ::uint64_t pos = 0;
+
+  for (std::size_t i = 0; i < count; i++) {
+    h.update(file->buf + pos, holes[i].off - pos);
+    pos = holes[i].off + holes[i].len;
+  }
 
-        // Read number
-        if (!readWord(p->fileBuffer, offset, asym.number)) {
-          PE_ERR(PEERR_MAGIC);
-          return false;
-        }
+  h.update(file->buf + pos, file->bufLen - pos);
+  h.final(out);
+}
 
-        // Read selection
-        if (!readByte(p->fileBuffer, offset, asym.selection)) {
-          PE_ERR(PEERR_MAGIC);
-          return false;
-        }
+bool ComputeAuthenticodeDigest(parsed_pe *pe,
+                               pe_digest_alg alg,
+                               ::uint8_t *digest) {
+  file_range holes[3];
+  std::size_t count;
+  bool found;
+  if (pe->peHeader.nt.OptionalMagic == NT_OPTIONAL_32_MAGIC) {
+    found = getAuthenticodeHoles<optional_header_32>(pe, holes, count);
+  } else {
+    found = getAuthenticodeHoles<optional_header_64>(pe, holes, count);
+  }
 
-        // Skip unused 3 bytes
-        offset += sizeof(uint8_t) * 3;
+  if (!found) {
+    PE_ERR(PEERR_READ);
+    return false;
+  }
 
-        // Save the record
-        sym.aux_symbols_f5.push_back(asym);
-      }
-    } else {
-      // Skip an unknown auxiliary record types
-      offset += sizeof(uint8_t) * SYMTAB_RECORD_LEN * sym.numberOfAuxSymbols;
-    }
+  if (alg == PE_DIGEST_SHA1) {
+    digestAround<sha1>(pe->fileBuffer, holes, count, digest);
+  } else {
+    digestAround<sha256>(pe->fileBuffer, holes, count, digest);
   }
 
   return true;
 }
 
-parsed_pe *ParsePEFromFile(const char *filePath) {
-  // First, create a new parsed_pe structure
-  // We pass std::nothrow parameter to new so in case of failure it returns
-  // nullptr instead of throwing exception std::bad_alloc.
-  parsed_pe *p = new (std::nothrow) parsed_pe();
+bool ComputePEChecksum(parsed_pe *pe, ::uint32_t &checksum) {
+  bounded_buffer *file = pe->fileBuffer;
 
-  if (p == nullptr) {
-    PE_ERR(PEERR_MEM);
-    return nullptr;
+  ::uint64_t off;
+  if (!getOptionalHeaderOffset(pe, off)) {
+    PE_ERR(PEERR_READ);
+    return false;
   }
 
-  // Make a new buffer object to hold just our file data
-  p->fileBuffer = readFileToFileBuffer(filePath);
+  // CheckSum is at the same offset in both optional headers
+  off += _offset(optional_header_32, CheckSum);
+  if (off > file->bufLen || file->bufLen - off < sizeof(::uint32_t)) {
+    PE_ERR(PEERR_READ);
+    return false;
+  }
 
-  if (p->fileBuffer == nullptr) {
-    delete p;
-    // err is set by readFileToFileBuffer
-    return nullptr;
+  // the CheckSum field counts as 0, so take its bytes back out of the sum
+  // as they were paired into words, which depends on where it starts
+  ::uint64_t sum = sumWords(file->buf, file->bufLen);
+  for (::uint64_t i = off; i < off + sizeof(::uint32_t); i++) {
+    sum -= static_cast<::uint64_t>(file->buf[i]) << ((i & 1) * 8);
   }
 
-  p->internal = new (std::nothrow) parsed_pe_internal();
+  // fold the carries back in, which is the ones' complement sum
+  while (sum > 0xFFFF) {
+    sum = (sum & 0xFFFF) + (sum >> 16);
+  }
 
-  if (p->internal == nullptr) {
-    deleteBuffer(p->fileBuffer);
-    delete p;
-    PE_ERR(PEERR_MEM);
-    return nullptr;
+  checksum = static_cast<::uint32_t>(sum + file->bufLen);
+  return true;
+}
+
+pe_view<exportent> GetExports(parsed_pe *pe) {
+  arena_vector<exportent> &l = pe->internal->exports;
+
+  ensureParsed(pe, PE_PARSE_EXPORTS, l);
+
+  return pe_view<exportent>(l.data(), l.data() + l.size());
+}
+
+// FNV-1a, export names are short so this beats anything fancier
+static ::uint32_t hashName(const char *b, const char *e) {
+  ::uint32_t h = 2166136261U;
+  for (; b != e; b++) {
+    h = (h ^ static_cast<::uint8_t>(*b)) * 16777619U;
   }
+  return h;
+}
 
-  // get header information
-  bounded_buffer *remaining = nullptr;
-  if (!getHeader(p->fileBuffer, p->peHeader, remaining)) {
-    deleteBuffer(p->fileBuffer);
-    delete p;
-    // err is set by getHeader
-    return nullptr;
+/*
+ * Build the export lookup tables. The name table is kept at most half
+ * full, and where several exports share a name or ordinal the first one
+ * wins.
+ */
+static void indexExports(parsed_pe *pe) {
+  parsed_pe_internal *pint = pe->internal;
+  pe_view<exportent> exps = GetExports(pe);
+
+  if (exps.empty()) {
+    return;
   }
 
-  bounded_buffer *file = p->fileBuffer;
-  if (!getSections(remaining, file, p->peHeader.nt, p->internal->secs)) {
-    deleteBuffer(remaining);
-    deleteBuffer(p->fileBuffer);
-    delete p;
-    PE_ERR(PEERR_SECT);
-    return nullptr;
+  std::size_t cap = 8;
+  while (cap < exps.size() * 2) {
+    cap *= 2;
   }
 
-  if (!getResources(remaining, file, p->internal->secs, p->internal->rsrcs)) {
-    deleteBuffer(remaining);
-    deleteBuffer(p->fileBuffer);
-    delete p;
-    PE_ERR(PEERR_RESC);
-    return nullptr;
+  // index by EAT slot rather than by ordinal, as OrdinalBase comes from
+  // the file and can put the ordinals anywhere. The slots of named exports
+  // come from the 16 bit ordinal table and the rest are bounded by the EAT
+  ::uint32_t highSlot = 0;
+  for (const exportent &e : exps) {
+    highSlot = std::max(highSlot, e.ordinal - pint->expOrdinalBase);
   }
 
-  // Get exports
-  if (!getExports(p)) {
-    deleteBuffer(remaining);
-    deleteBuffer(p->fileBuffer);
-    delete p;
-    PE_ERR(PEERR_MAGIC);
-    return nullptr;
+  pint->expByName.assign(cap, 0);
+  pint->expByOrdinal.assign(static_cast<std::size_t>(highSlot) + 1, 0);
+
+  std::size_t mask = cap - 1;
+  for (std::size_t i = 0; i < exps.size(); i++) {
+    const exportent &e = exps[i];
+
+    ::uint32_t &ordSlot =
+        pint->expByOrdinal[e.ordinal - pint->expOrdinalBase];
+    if (ordSlot == 0) {
+      ordSlot = static_cast<::uint32_t>(i + 1);
+    }
+
+    if (e.symbolName.empty()) {
+      continue;
+    }
+
+    std::size_t slot = hashName(e.symbolName.begin(), e.symbolName.end());
+    for (;; slot++) {
+      ::uint32_t &n = pint->expByName[slot & mask];
+      if (n == 0) {
+        n = static_cast<::uint32_t>(i + 1);
+        break;
+      }
+      if (exps[n - 1].symbolName == e.symbolName) {
+        break;
+      }
+    }
   }
+}
 
-  // Get relocations, if exist
-  if (!getRelocations(p)) {
-    deleteBuffer(remaining);
-    deleteBuffer(p->fileBuffer);
-    delete p;
-    PE_ERR(PEERR_MAGIC);
+// build the export lookup tables unless that is already done. Callers that
+// get here at once wait for the first one to build them
+static void ensureExportsIndexed(parsed_pe *pe) {
+  std::call_once(pe->internal->expIndexed, indexExports, pe);
+}
+
+const exportent *FindExportByName(parsed_pe *pe, pe_string_view name) {
+  parsed_pe_internal *pint = pe->internal;
+
+  ensureExportsIndexed(pe);
+
+  if (pint->expByName.empty()) {
     return nullptr;
   }
 
-  // Get imports
-  if (!getImports(p)) {
-    deleteBuffer(remaining);
-    deleteBuffer(p->fileBuffer);
-    delete p;
-    return nullptr;
+  const exportent *exps = pint->exports.data();
+  std::size_t mask = pint->expByName.size() - 1;
+  std::size_t slot = hashName(name.begin(), name.end());
+  for (;; slot++) {
+    ::uint32_t n = pint->expByName[slot & mask];
+    if (n == 0) {
+      return nullptr;
+    }
+    if (exps[n - 1].symbolName == name) {
+      return &exps[n - 1];
+    }
   }
+}
 
-  // Get symbol table
-  if (!getSymbolTable(p)) {
-    deleteBuffer(remaining);
-    deleteBuffer(p->fileBuffer);
-    delete p;
+const exportent *FindExportByName(parsed_pe *pe, const char *name) {
+  return FindExportByName(pe, pe_string_view(name, strlen(name)));
+}
+
+const exportent *FindExportByOrdinal(parsed_pe *pe, std::uint32_t ordinal) {
+  parsed_pe_internal *pint = pe->internal;
+
+  ensureExportsIndexed(pe);
+
+  // an ordinal below the base wraps around to something out of range
+  ::uint32_t i = ordinal - pint->expOrdinalBase;
+  if (i >= pint->expByOrdinal.size() || pint->expByOrdinal[i] == 0) {
     return nullptr;
   }
 
-  deleteBuffer(remaining);
+  return &pint->exports[pint->expByOrdinal[i] - 1];
+}
+
+pe_view<reloc> GetRelocations(parsed_pe *pe) {
+  arena_vector<reloc> &l = pe->internal->relocs;
 
-  return p;
+  ensureParsed(pe, PE_PARSE_RELOCATIONS, l);
+
+  return pe_view<reloc>(l.data(), l.data() + l.size());
 }
 
-void DestructParsedPE(parsed_pe *p) {
-  if (p == nullptr) {
-    return;
-  }
+pe_view<symbol> GetSymbols(parsed_pe *pe) {
+  arena_vector<symbol> &l = pe->internal->symbols;
 
-  deleteBuffer(p->fileBuffer);
+  ensureParsed(pe, PE_PARSE_SYMBOLS, l);
 
-  for (section s : p->internal->secs) {
-    if (s.sectionData != nullptr) {
-      deleteBuffer(s.sectionData);
+  return pe_view<symbol>(l.data(), l.data() + l.size());
+}
+
+pe_view<section> GetSections(parsed_pe *pe) {
+  arena_vector<section> &l = pe->internal->secs;
+
+  return pe_view<section>(l.data(), l.data() + l.size());
+}
+
+// iterate over the imports by VA and string
+void IterImpVAString(parsed_pe *pe, iterVAStr cb, void *cbd) {
+  for (const importent &i : GetImports(pe)) {
+    string modName = i.moduleName.str();
+    string symName = i.symbolName.str();
+    if (cb(cbd, i.addr, modName, symName) != 0) {
+      break;
     }
   }
-  for (resource r : p->internal->rsrcs) {
-    if (r.buf != nullptr) {
-      deleteBuffer(r.buf);
+
+  return;
+}
+
+// iterate over the delay load imports by VA and string
+void IterDelayImpVAString(parsed_pe *pe, iterVAStr cb, void *cbd) {
+  for (const importent &i : GetDelayImports(pe)) {
+    string modName = i.moduleName.str();
+    string symName = i.symbolName.str();
+    if (cb(cbd, i.addr, modName, symName) != 0) {
+      break;
     }
   }
 
-  delete p->internal;
-  delete p;
   return;
 }
 
-// iterate over the imports by VA and string
-void IterImpVAString(parsed_pe *pe, iterVAStr cb, void *cbd) {
-  list<importent> &l = pe->internal->imports;
-
-  for (importent i : l) {
-    if (cb(cbd, i.addr, i.moduleName, i.symbolName) != 0) {
+// iterate over the TLS callbacks
+void IterTLSCallbacks(parsed_pe *pe, iterTLSCallback cb, void *cbd) {
+  for (VA v : GetTLSCallbacks(pe)) {
+    if (cb(cbd, v) != 0) {
       break;
     }
   }
@@ -1740,9 +4154,7 @@ void IterImpVAString(parsed_pe *pe, iterVAStr cb, void *cbd) {
 
 // iterate over relocations in the PE file
 void IterRelocs(parsed_pe *pe, iterReloc cb, void *cbd) {
-  list<reloc> &l = pe->internal->relocs;
-
-  for (reloc r : l) {
+  for (const reloc &r : GetRelocations(pe)) {
     if (cb(cbd, r.shiftedAddr, r.type) != 0) {
       break;
     }
@@ -1753,16 +4165,20 @@ void IterRelocs(parsed_pe *pe, iterReloc cb, void *cbd) {
 
 // Iterate over symbols (symbol table) in the PE file
 void IterSymbols(parsed_pe *pe, iterSymbol cb, void *cbd) {
-  list<symbol> &l = pe->internal->symbols;
-
-  for (symbol s : l) {
+  for (const symbol &s : GetSymbols(pe)) {
+    string strName = s.strName.str();
+    uint32_t value = s.value;
+    int16_t sectionNumber = s.sectionNumber;
+    uint16_t type = s.type;
+    uint8_t storageClass = s.storageClass;
+    uint8_t numberOfAuxSymbols = s.numberOfAuxSymbols;
     if (cb(cbd,
-           s.strName,
-           s.value,
-           s.sectionNumber,
-           s.type,
-           s.storageClass,
-           s.numberOfAuxSymbols) != 0) {
+           strName,
+           value,
+           sectionNumber,
+           type,
+           storageClass,
+           numberOfAuxSymbols) != 0) {
       break;
     }
   }
@@ -1772,10 +4188,15 @@ void IterSymbols(parsed_pe *pe, iterSymbol cb, void *cbd) {
 
 // iterate over the exports by VA
 void IterExpVA(parsed_pe *pe, iterExp cb, void *cbd) {
-  list<exportent> &l = pe->internal->exports;
+  for (const exportent &i : GetExports(pe)) {
+    // a forwarder has no code in this image to give the VA of
+    if (!i.forwarderName.empty()) {
+      continue;
+    }
 
-  for (exportent i : l) {
-    if (cb(cbd, i.addr, i.moduleName, i.symbolName) != 0) {
+    string modName = i.moduleName.str();
+    string symName = i.symbolName.str();
+    if (cb(cbd, i.addr, modName, symName) != 0) {
       break;
     }
   }
@@ -1785,10 +4206,9 @@ void IterExpVA(parsed_pe *pe, iterExp cb, void *cbd) {
 
 // iterate over sections
 void IterSec(parsed_pe *pe, iterSec cb, void *cbd) {
-  parsed_pe_internal *pint = pe->internal;
-
-  for (section s : pint->secs) {
-    if (cb(cbd, s.sectionBase, s.sectionName, s.sec, s.sectionData) != 0) {
+  for (const section &s : GetSections(pe)) {
+    string name = s.sectionName.str();
+    if (cb(cbd, s.sectionBase, name, s.sec, s.sectionData) != 0) {
       break;
     }
   }
@@ -1798,16 +4218,16 @@ void IterSec(parsed_pe *pe, iterSec cb, void *cbd) {
 
 bool ReadByteAtVA(parsed_pe *pe, VA v, ::uint8_t &b) {
   // find this VA in a section
-  section s;
+  const section *s;
 
-  if (!getSecForVA(pe->internal->secs, v, s)) {
+  if (!getSecForVA(pe->internal->secIndex, v, s)) {
     PE_ERR(PEERR_SECTVA);
     return false;
   }
 
-  ::uint32_t off = v - s.sectionBase;
+  ::uint32_t off = v - s->sectionBase;
 
-  return readByte(s.sectionData, off, b);
+  return readByte(s->sectionData, off, b);
 }
 
 bool GetEntryPoint(parsed_pe *pe, VA &v) {
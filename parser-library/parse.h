@@ -24,7 +24,9 @@ THE SOFTWARE.
 
 #ifndef _PARSE_H
 #define _PARSE_H
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <string>
 
 #include "nt-headers.h"
@@ -34,10 +36,7 @@ THE SOFTWARE.
 #define __typeof__(x) std::remove_reference < decltype(x) > ::type
 #endif
 
-#define PE_ERR(x)           \
-  err = (pe_err) x;         \
-  err_loc.assign(__func__); \
-  err_loc += ":" + to_string<std::uint32_t>(__LINE__, dec);
+#define PE_ERR(x) setPEErr((pe_err) x, __func__, __LINE__);
 
 #define READ_WORD(b, o, inst, member)                                     \
   if (!readWord(b, o + _offset(__typeof__(inst), member), inst.member)) { \
@@ -88,7 +87,7 @@ struct buffer_detail;
 
 typedef struct _bounded_buffer {
   std::uint8_t *buf;
-  std::uint32_t bufLen;
+  std::uint64_t bufLen;
   bool copy;
   bool swapBytes;
   buffer_detail *detail;
@@ -142,23 +141,471 @@ enum pe_err {
   PEERR_READ = 6,
   PEERR_OPEN = 7,
   PEERR_STAT = 8,
-  PEERR_MAGIC = 9
+  PEERR_MAGIC = 9,
+  PEERR_CALLBACK = 10
 };
 
-bool readByte(bounded_buffer *b, std::uint32_t offset, std::uint8_t &out);
-bool readWord(bounded_buffer *b, std::uint32_t offset, std::uint16_t &out);
-bool readDword(bounded_buffer *b, std::uint32_t offset, std::uint32_t &out);
-bool readQword(bounded_buffer *b, std::uint32_t offset, std::uint64_t &out);
+/*
+ * Where and why a call failed. func is the __func__ of the function that
+ * raised the error, so it is a static string and recording an error never
+ * allocates.
+ */
+typedef struct _pe_error {
+  pe_err code;
+  const char *func;
+  std::uint32_t line;
+} pe_error;
+
+// record an error for the calling thread, this is what PE_ERR expands to
+void setPEErr(pe_err code, const char *func, std::uint32_t line);
+
+// buffer offsets and lengths are 64 bit so that images and dumps past
+// 4 GiB can be addressed, the reads fail unless the whole value is in b
+bool readByte(bounded_buffer *b, std::uint64_t offset, std::uint8_t &out);
+bool readWord(bounded_buffer *b, std::uint64_t offset, std::uint16_t &out);
+bool readDword(bounded_buffer *b, std::uint64_t offset, std::uint32_t &out);
+bool readQword(bounded_buffer *b, std::uint64_t offset, std::uint64_t &out);
+
+// an integer field of an on-disk struct, count elements of size bytes
+// each starting at offset. Lists of these end with a zero size entry
+typedef struct _field_desc {
+  std::uint32_t offset;
+  std::uint32_t size;
+  std::uint32_t count;
+} field_desc;
+
+// copy len bytes at offset into out with a single bounds check. Only when
+// the buffer is byte swapped are the fields of each stride byte record in
+// out swapped, fields that don't fit entirely into len are left as read
+bool readFields(bounded_buffer *b,
+                std::uint64_t offset,
+                void *out,
+                std::uint32_t len,
+                std::uint32_t stride,
+                const field_desc *fields);
 
 bounded_buffer *readFileToFileBuffer(const char *filePath);
+bounded_buffer *makeBufferFromPointer(std::uint8_t *data, std::uint64_t sz);
 bounded_buffer *
-splitBuffer(bounded_buffer *b, std::uint32_t from, std::uint32_t to);
+splitBuffer(bounded_buffer *b, std::uint64_t from, std::uint64_t to);
 void deleteBuffer(bounded_buffer *b);
 uint64_t bufLen(bounded_buffer *b);
 
+/*
+ * A string held by a parsed_pe, valid until the parsed_pe is destructed.
+ * It is not NUL terminated.
+ */
+class pe_string_view {
+public:
+  pe_string_view() : ptr(nullptr), len(0) {
+  }
+
+  pe_string_view(const char *p, std::size_t n) : ptr(p), len(n) {
+  }
+
+  const char *data() const {
+    return ptr;
+  }
+
+  std::size_t size() const {
+    return len;
+  }
+
+  bool empty() const {
+    return len == 0;
+  }
+
+  const char *begin() const {
+    return ptr;
+  }
+
+  const char *end() const {
+    return ptr + len;
+  }
+
+  char operator[](std::size_t i) const {
+    return ptr[i];
+  }
+
+  std::string str() const {
+    return len == 0 ? std::string() : std::string(ptr, len);
+  }
+
+private:
+  const char *ptr;
+  std::size_t len;
+};
+
+inline bool operator==(const pe_string_view &a, const pe_string_view &b) {
+  return a.size() == b.size() &&
+         (a.size() == 0 || std::memcmp(a.data(), b.data(), a.size()) == 0);
+}
+
+inline bool operator!=(const pe_string_view &a, const pe_string_view &b) {
+  return !(a == b);
+}
+
+inline bool operator==(const pe_string_view &a, const char *b) {
+  return a == pe_string_view(b, std::strlen(b));
+}
+
+inline bool operator!=(const pe_string_view &a, const char *b) {
+  return !(a == b);
+}
+
+inline bool operator==(const pe_string_view &a, const std::string &b) {
+  return a == pe_string_view(b.data(), b.size());
+}
+
+inline bool operator!=(const pe_string_view &a, const std::string &b) {
+  return !(a == b);
+}
+
+/*
+ * A read only range over entries held by a parsed_pe. The elements are
+ * the parsed data itself, so walking a view neither copies nor allocates.
+ * It is valid until the parsed_pe is destructed.
+ */
+template <class T>
+class pe_view {
+public:
+  typedef T value_type;
+  typedef const T *iterator;
+  typedef const T *const_iterator;
+
+  pe_view() : first(nullptr), last(nullptr) {
+  }
+
+  pe_view(const T *b, const T *e) : first(b), last(e) {
+  }
+
+  const T *begin() const {
+    return first;
+  }
+
+  const T *end() const {
+    return last;
+  }
+
+  std::size_t size() const {
+    return last - first;
+  }
+
+  bool empty() const {
+    return first == last;
+  }
+
+  const T &operator[](std::size_t i) const {
+    return first[i];
+  }
+
+private:
+  const T *first;
+  const T *last;
+};
+
+/*
+ * A read only view of a table of RVAs in the image, such as the CFG
+ * function table. Entries are stride bytes apart, and any bytes after the
+ * RVA are flags. The table is read in place, one entry at a time, so it is
+ * never copied however large it is. Like pe_view it is valid until the
+ * parsed_pe is destructed.
+ */
+class pe_rva_table {
+public:
+  class iterator {
+  public:
+    iterator(const pe_rva_table *t, std::size_t i) : table(t), idx(i) {
+    }
+
+    std::uint32_t operator*() const {
+      return (*table)[idx];
+    }
+
+    iterator &operator++() {
+      idx++;
+      return *this;
+    }
+
+    bool operator==(const iterator &o) const {
+      return idx == o.idx;
+    }
+
+    bool operator!=(const iterator &o) const {
+      return idx != o.idx;
+    }
+
+  private:
+    const pe_rva_table *table;
+    std::size_t idx;
+  };
+
+  pe_rva_table() : data(nullptr), count(0), stride(4) {
+  }
+
+  pe_rva_table(const std::uint8_t *d, std::size_t n, std::uint32_t s)
+      : data(d), count(n), stride(s) {
+  }
+
+  iterator begin() const {
+    return iterator(this, 0);
+  }
+
+  iterator end() const {
+    return iterator(this, count);
+  }
+
+  std::size_t size() const {
+    return count;
+  }
+
+  bool empty() const {
+    return count == 0;
+  }
+
+  // the RVA of entry i, which is always little endian in the image
+  std::uint32_t operator[](std::size_t i) const {
+    const std::uint8_t *e = data + i * stride;
+    return static_cast<std::uint32_t>(e[0]) |
+           (static_cast<std::uint32_t>(e[1]) << 8) |
+           (static_cast<std::uint32_t>(e[2]) << 16) |
+           (static_cast<std::uint32_t>(e[3]) << 24);
+  }
+
+  // the first flag byte of entry i, 0 when the table has none
+  std::uint8_t flags(std::size_t i) const {
+    return stride > 4 ? data[i * stride + 4] : 0;
+  }
+
+private:
+  const std::uint8_t *data;
+  std::size_t count;
+  std::uint32_t stride;
+};
+
+// a section header, sectionData is null when its raw data isn't in the file
+struct section {
+  pe_string_view sectionName;
+  std::uint64_t sectionBase;
+  bounded_buffer *sectionData;
+  image_section_header sec;
+};
+
+// an imported symbol, addr is the VA of its IAT slot
+struct importent {
+  VA addr;
+  pe_string_view symbolName;
+  pe_string_view moduleName;
+};
+
+// an exported symbol. ordinal is biased by the directory's ordinal base, as
+// it would be written in an import, and symbolName is empty for exports by
+// ordinal only. A forwarded export has the name it is forwarded to in
+// forwarderName, e.g. NTDLL.RtlAllocateHeap, and addr is where that is
+struct exportent {
+  VA addr;
+  std::uint32_t ordinal;
+  pe_string_view symbolName;
+  pe_string_view moduleName;
+  pe_string_view forwarderName;
+};
+
+// a bound import descriptor, or one of the forwarder refs that follow it.
+// A ref names a module the bound module forwards to, and the binding is
+// stale if a timeDateStamp doesn't match the one in that module's header
+struct boundimportent {
+  pe_string_view moduleName;
+  std::uint32_t timeDateStamp;
+  // the number of refs that follow a descriptor, always 0 for a ref
+  std::uint16_t forwarderRefs;
+  bool isForwarderRef;
+};
+
+// a slot of the import address table as it is in the file. Unless the
+// image is bound, a slot holds the same value as its import lookup table
+// entry, anything else means it was patched
+struct iatent {
+  VA addr;
+  std::uint64_t value;
+};
+
+// the identity a symbol server files a PDB under, taken from the CodeView
+// debug record. cvSignature is CV_SIGNATURE_RSDS or CV_SIGNATURE_NB10. NB10
+// records predate the GUID and have a timestamp signature in its place,
+// which ends up in pdbGuid.Data1. pdbPath points into the file
+struct pdb_info {
+  std::uint32_t cvSignature;
+  guid pdbGuid;
+  std::uint32_t age;
+  pe_string_view pdbPath;
+};
+
+// the TLS directory, with the addresses of either image width as VAs
+struct tls_directory {
+  VA startAddressOfRawData;
+  VA endAddressOfRawData;
+  VA addressOfIndex;
+  VA addressOfCallBacks;
+  std::uint32_t sizeOfZeroFill;
+  std::uint32_t characteristics;
+};
+
+// an entry of the attribute certificate table. data is the certificate
+// itself and points into the file. For WIN_CERT_TYPE_PKCS_SIGNED_DATA it is
+// the PKCS #7 SignedData of an Authenticode signature
+struct certificate {
+  std::uint16_t revision;
+  std::uint16_t type;
+  pe_view<std::uint8_t> data;
+};
+
+// the root of the CLR metadata. version names the runtime the image was
+// built against, e.g. v4.0.30319, and data is the whole of the metadata as
+// it is in the image
+struct clr_metadata {
+  std::uint16_t majorVersion;
+  std::uint16_t minorVersion;
+  pe_string_view version;
+  std::uint16_t flags;
+  pe_view<std::uint8_t> data;
+};
+
+// a stream of the CLR metadata, such as the #~ tables or the #Strings
+// heap. offset is from the metadata root and data is the stream as it is
+// in the image, cut short if it runs past the section data
+struct clr_stream {
+  pe_string_view name;
+  std::uint32_t offset;
+  pe_view<std::uint8_t> data;
+};
+
+// a directory of the resource tree. offset is from the start of the tree,
+// and the named entries come before the ones with an ID
+struct resource_dir {
+  std::uint32_t offset;
+  std::uint16_t nameEntries;
+  std::uint16_t idEntries;
+};
+
+// an entry of a resource directory, keyed by either an ID or a name. The
+// name is the UTF-16LE string as it is in the image, without its length.
+// offset is that of the subdirectory or data entry the entry leads to
+struct resource_node {
+  bool named;
+  std::uint32_t id;
+  pe_string_view name;
+  bool isDir;
+  std::uint32_t offset;
+};
+
+// a resource's data entry. data is the resource as it is in the image, cut
+// short if it runs past the section data
+struct resource_data {
+  std::uint32_t RVA;
+  std::uint32_t size;
+  std::uint32_t codepage;
+  pe_view<std::uint8_t> data;
+};
+
+// matches whichever language comes first in FindResourceData
+constexpr std::uint32_t RESOURCE_ANY_LANG = 0xFFFFFFFF;
+
+// the digests an Authenticode signature can be made with
+enum pe_digest_alg { PE_DIGEST_SHA1, PE_DIGEST_SHA256 };
+
+// a base relocation
+struct reloc {
+  VA shiftedAddr;
+  reloc_type type;
+};
+
+// a COFF symbol table entry with its auxiliary records
+union symbol_name {
+  std::uint8_t shortName[NT_SHORT_NAME_LEN];
+  std::uint32_t zeroes;
+  std::uint64_t data;
+};
+
+struct aux_symbol_f1 {
+  std::uint32_t tagIndex;
+  std::uint32_t totalSize;
+  std::uint32_t pointerToLineNumber;
+  std::uint32_t pointerToNextFunction;
+};
+
+struct aux_symbol_f2 {
+  std::uint16_t lineNumber;
+  std::uint32_t pointerToNextFunction;
+};
+
+struct aux_symbol_f3 {
+  std::uint32_t tagIndex;
+  std::uint32_t characteristics;
+};
+
+struct aux_symbol_f4 {
+  std::uint8_t filename[SYMTAB_RECORD_LEN];
+  pe_string_view strFilename;
+};
+
+struct aux_symbol_f5 {
+  std::uint32_t length;
+  std::uint16_t numberOfRelocations;
+  std::uint16_t numberOfLineNumbers;
+  std::uint32_t checkSum;
+  std::uint16_t number;
+  std::uint8_t selection;
+};
+
+// a COFF symbol. Only the auxiliary records of the format its storage
+// class calls for are filled in, the rest are empty
+struct symbol {
+  pe_string_view strName;
+  symbol_name name;
+  std::uint32_t value;
+  std::int16_t sectionNumber;
+  std::uint16_t type;
+  std::uint8_t storageClass;
+  std::uint8_t numberOfAuxSymbols;
+  pe_view<aux_symbol_f1> aux_symbols_f1;
+  pe_view<aux_symbol_f2> aux_symbols_f2;
+  pe_view<aux_symbol_f3> aux_symbols_f3;
+  pe_view<aux_symbol_f4> aux_symbols_f4;
+  pe_view<aux_symbol_f5> aux_symbols_f5;
+};
+
 struct parsed_pe_internal;
 
-typedef struct _pe_header { nt_header_32 nt; } pe_header;
+// one record of the Rich header, the number of objects a tool built
+struct rich_entry {
+  std::uint16_t productId;
+  std::uint16_t build;
+  std::uint32_t count;
+};
+
+constexpr std::size_t RICH_MAX_ENTRIES = 64;
+
+/*
+ * The Rich header the Microsoft linker leaves between the DOS stub and the
+ * NT headers, decoded. Records past the first RICH_MAX_ENTRIES are counted
+ * in totalEntries but not kept. checksumValid says whether the XOR key
+ * matches the checksum of the DOS header and records, which it won't if
+ * either was edited after linking.
+ */
+struct rich_header {
+  bool present;
+  bool checksumValid;
+  std::uint32_t key;
+  std::uint32_t offset;
+  std::uint32_t totalEntries;
+  std::uint32_t count;
+  rich_entry entries[RICH_MAX_ENTRIES];
+};
+
+typedef struct _pe_header {
+  nt_header_32 nt;
+  rich_header rich;
+} pe_header;
 
 typedef struct _parsed_pe {
   bounded_buffer *fileBuffer;
@@ -166,6 +613,9 @@ typedef struct _parsed_pe {
   pe_header peHeader;
 } parsed_pe;
 
+// the error state is kept per thread, these report the last error raised
+// on the calling thread
+
 // get parser error status as integer
 int GetPEErr();
 
@@ -175,20 +625,151 @@ std::string GetPEErrString();
 // get parser error location as string
 std::string GetPEErrLoc();
 
-// get a PE parse context from a file
-parsed_pe *ParsePEFromFile(const char *filePath);
+// get parser error status and location without allocating
+pe_error GetPEErrInfo();
+
+// get the description of an error code
+const char *GetPEErrDescription(pe_err code);
+
+/*
+ * Which data directories a parse reads. The headers and the section table
+ * are always read, everything else only when its flag is given. With
+ * PE_PARSE_LAZY a selected directory is parsed the first time one of its
+ * Iter functions is called rather than up front, and the result is kept for
+ * later calls. A lazily parsed directory that turns out to be malformed
+ * yields nothing and sets the error state of the calling thread. Lazy
+ * parsing mutates the parsed_pe, so the first Iter call for a directory
+ * must not race with other calls on the same parsed_pe.
+ */
+enum pe_parse_flags {
+  PE_PARSE_RESOURCES = 0x1,
+  PE_PARSE_EXPORTS = 0x2,
+  PE_PARSE_RELOCATIONS = 0x4,
+  PE_PARSE_IMPORTS = 0x8,
+  PE_PARSE_SYMBOLS = 0x10,
+  PE_PARSE_DELAY_IMPORTS = 0x20,
+  PE_PARSE_BOUND_IMPORTS = 0x40,
+  PE_PARSE_IAT = 0x80,
+  PE_PARSE_EXCEPTIONS = 0x100,
+  PE_PARSE_TLS = 0x200,
+  PE_PARSE_DEBUG = 0x400,
+  PE_PARSE_LOAD_CONFIG = 0x800,
+  PE_PARSE_CERTIFICATES = 0x1000,
+  PE_PARSE_CLR = 0x2000,
+  PE_PARSE_ALL = 0x3FFF,
+  PE_PARSE_LAZY = 0x80000000
+};
+
+// get a PE parse context from a file, flags is a mask of pe_parse_flags
+parsed_pe *ParsePEFromFile(const char *filePath,
+                           std::uint32_t flags = PE_PARSE_ALL);
+
+// same as above, err receives the outcome of this particular call
+parsed_pe *ParsePEFromFile(const char *filePath,
+                           pe_error &err,
+                           std::uint32_t flags = PE_PARSE_ALL);
+
+// get a PE parse context from memory owned by the caller, the memory is not
+// copied and has to stay valid until DestructParsedPE is called
+parsed_pe *ParsePEFromBuffer(const std::uint8_t *buffer,
+                             std::size_t sz,
+                             std::uint32_t flags = PE_PARSE_ALL);
+
+// same as above, err receives the outcome of this particular call
+parsed_pe *ParsePEFromBuffer(const std::uint8_t *buffer,
+                             std::size_t sz,
+                             pe_error &err,
+                             std::uint32_t flags = PE_PARSE_ALL);
 
 // destruct a PE context
 void DestructParsedPE(parsed_pe *p);
 
+// one input of a batch parse, the file at path when path is set and
+// otherwise the size bytes at buffer, which have to outlive the batch
+typedef struct _pe_batch_item {
+  const char *path;
+  const std::uint8_t *buffer;
+  std::size_t size;
+} pe_batch_item;
+
+/*
+ * Receives each batch result as it completes, pe is nullptr when the parse
+ * failed and err says why. pe is destructed once the callback returns.
+ * Callbacks run on the worker threads and may run concurrently, returning
+ * non-zero keeps the batch from starting any further items. Exceptions
+ * don't leave the workers: one from a parse fails its item with
+ * PEERR_MEM, and when the callback throws it is called once more for the
+ * item with pe nullptr and PEERR_CALLBACK, and what that call throws is
+ * dropped.
+ */
+typedef int (*iterBatch)(void *,
+                         std::size_t index,
+                         parsed_pe *pe,
+                         const pe_error &err);
+
+/*
+ * Parse count items on threads worker threads, 0 uses one per hardware
+ * thread. The calling thread is one of the workers and the call returns
+ * once every started item has been delivered. Each worker starts on the
+ * largest of its items, which costs it a stat of every file it was dealt
+ * before its first parse. Buffer items cost nothing to size.
+ */
+void ParsePEBatch(const pe_batch_item *items,
+                  std::size_t count,
+                  std::uint32_t threads,
+                  iterBatch cb,
+                  void *cbd,
+                  std::uint32_t flags = PE_PARSE_ALL);
+
 // iterate over the resources
 typedef int (*iterRsrc)(void *, resource);
 void IterRsrc(parsed_pe *pe, iterRsrc cb, void *cbd);
 
+/*
+ * Walk the resource tree a node at a time. Each call reads just the entry
+ * it is asked for straight from the image, whatever directories the parse
+ * was asked for, and nothing is allocated. The root's children are keyed
+ * by type, theirs by name and theirs by language, whose entries lead to
+ * the data.
+ */
+bool GetResourceRoot(parsed_pe *pe, resource_dir &root);
+bool GetResourceChild(parsed_pe *pe,
+                      const resource_dir &dir,
+                      std::uint32_t index,
+                      resource_node &node);
+bool OpenResourceDir(parsed_pe *pe,
+                     const resource_node &node,
+                     resource_dir &dir);
+bool GetResourceData(parsed_pe *pe,
+                     const resource_node &node,
+                     resource_data &data);
+
+// find the child of a directory with an ID, or with a name compared
+// without regard to ASCII case
+bool FindResourceChild(parsed_pe *pe,
+                       const resource_dir &dir,
+                       std::uint32_t id,
+                       resource_node &node);
+bool FindResourceChild(parsed_pe *pe,
+                       const resource_dir &dir,
+                       const char *name,
+                       resource_node &node);
+
+// find the data of a resource by its type, name and language IDs, reading
+// only the directories on the way to it
+bool FindResourceData(parsed_pe *pe,
+                      std::uint32_t type,
+                      std::uint32_t name,
+                      std::uint32_t lang,
+                      resource_data &data);
+
 // iterate over the imports by RVA and string
 typedef int (*iterVAStr)(void *, VA, std::string &, std::string &);
 void IterImpVAString(parsed_pe *pe, iterVAStr cb, void *cbd);
 
+// iterate over the delay load imports, addr is the VA of the delay IAT slot
+void IterDelayImpVAString(parsed_pe *pe, iterVAStr cb, void *cbd);
+
 // iterate over relocations in the PE file
 typedef int (*iterReloc)(void *, VA, reloc_type);
 void IterRelocs(parsed_pe *pe, iterReloc cb, void *cbd);
@@ -203,15 +784,113 @@ typedef int (*iterSymbol)(void *,
                           uint8_t &);
 void IterSymbols(parsed_pe *pe, iterSymbol cb, void *cbd);
 
-// iterate over the exports
+// iterate over the exports that have code in this image, leaving out the
+// forwarders. The name is empty for exports by ordinal only
 typedef int (*iterExp)(void *, VA, std::string &, std::string &);
 void IterExpVA(parsed_pe *pe, iterExp cb, void *cbd);
 
+// iterate over the TLS callbacks in the order the loader calls them
+typedef int (*iterTLSCallback)(void *, VA callback);
+void IterTLSCallbacks(parsed_pe *pe, iterTLSCallback cb, void *cbd);
+
 // iterate over sections
 typedef int (*iterSec)(
     void *, VA secBase, std::string &, image_section_header, bounded_buffer *b);
 void IterSec(parsed_pe *pe, iterSec cb, void *cbd);
 
+/*
+ * Views over the parsed data. They reference the parsed_pe, so they are
+ * valid until it is destructed, and in lazy mode the first call parses the
+ * directory. The Iter functions above are wrappers around these.
+ */
+pe_view<importent> GetImports(parsed_pe *pe);
+pe_view<importent> GetDelayImports(parsed_pe *pe);
+pe_view<boundimportent> GetBoundImports(parsed_pe *pe);
+pe_view<iatent> GetIAT(parsed_pe *pe);
+pe_view<exportent> GetExports(parsed_pe *pe);
+pe_view<reloc> GetRelocations(parsed_pe *pe);
+pe_view<symbol> GetSymbols(parsed_pe *pe);
+pe_view<section> GetSections(parsed_pe *pe);
+
+/*
+ * Look up an export, nullptr when the image has no such export. Lookups are
+ * constant time, from tables that the parse builds when it reads the
+ * exports up front and that the first lookup builds otherwise. Lookups can
+ * run on any number of threads at once on the same parsed_pe. With
+ * PE_PARSE_LAZY the first one also parses the exports, so it must not race
+ * with other calls that read them, such as GetExports. The result is valid
+ * until the parsed_pe is destructed.
+ */
+const exportent *FindExportByName(parsed_pe *pe, pe_string_view name);
+const exportent *FindExportByName(parsed_pe *pe, const char *name);
+const exportent *FindExportByOrdinal(parsed_pe *pe, std::uint32_t ordinal);
+
+/*
+ * The function table of the exception directory, sorted by BeginAddress,
+ * for x64, Itanium, ARM and ARM64 images. All addresses are RVAs. ARM
+ * tables don't store where a function ends, so EndAddress is worked out
+ * from the unwind data and UnwindInfoAddress holds the raw unwind word,
+ * which is either packed unwind data or the RVA of the .xdata record
+ */
+pe_view<runtime_function> GetFunctionTable(parsed_pe *pe);
+
+// find the function table entry covering v, nullptr when there is none
+const runtime_function *FindFunctionForVA(parsed_pe *pe, VA v);
+
+// the entries of the debug directory
+pe_view<debug_dir_entry> GetDebugEntries(parsed_pe *pe);
+
+// decode the image's CodeView record, false when it has none. This reads
+// straight from the file without allocating, whatever directories the
+// parse was asked for, so a parse with flags 0 is enough to get it
+bool GetPDBInfo(parsed_pe *pe, pdb_info &info);
+
+// get the TLS directory, false when the image has none
+bool GetTLSDirectory(parsed_pe *pe, tls_directory &tls);
+pe_view<VA> GetTLSCallbacks(parsed_pe *pe);
+
+// get the load config directory, false when the image has none. A PE32
+// image's is widened, and fields past the Size it gives are zero
+bool GetLoadConfig(parsed_pe *pe, load_config_64 &lc);
+
+// the tables the load config points at, empty when the image has none.
+// The guard tables carry the GuardFlags count of flag bytes per entry, and
+// the SEH handler table is only found in PE32 images
+pe_rva_table GetGuardCFFunctionTable(parsed_pe *pe);
+pe_rva_table GetGuardAddressTakenIatTable(parsed_pe *pe);
+pe_rva_table GetGuardLongJumpTargetTable(parsed_pe *pe);
+pe_rva_table GetGuardEHContinuationTable(parsed_pe *pe);
+pe_rva_table GetSEHandlerTable(parsed_pe *pe);
+
+/*
+ * The CLR header and metadata of a .NET image, false when it isn't one.
+ * Only the metadata root and stream headers are read, the streams are
+ * views into the image that are left for the caller to decode.
+ */
+bool GetCLRHeader(parsed_pe *pe, clr_header &clr);
+bool GetCLRMetadata(parsed_pe *pe, clr_metadata &md);
+pe_view<clr_stream> GetCLRStreams(parsed_pe *pe);
+
+// find a metadata stream by name, e.g. "#Blob", nullptr when there is none
+const clr_stream *FindCLRStream(parsed_pe *pe, const char *name);
+
+// the entries of the attribute certificate table
+pe_view<certificate> GetCertificates(parsed_pe *pe);
+
+/*
+ * Compute the Authenticode digest of the image, which is what a signature
+ * in the certificate table signs. digest must have room for 20 bytes for
+ * SHA-1 and 32 for SHA-256. The file is hashed in place in one pass,
+ * whatever directories the parse was asked for.
+ */
+bool ComputeAuthenticodeDigest(parsed_pe *pe,
+                               pe_digest_alg alg,
+                               std::uint8_t *digest);
+
+// compute the CheckSum the optional header should have, which a mismatch
+// with the one it has shows the file was changed after it was linked
+bool ComputePEChecksum(parsed_pe *pe, std::uint32_t &checksum);
+
 // get byte at VA in PE
 bool ReadByteAtVA(parsed_pe *pe, VA v, std::uint8_t &b);
 
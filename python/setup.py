@@ -34,6 +34,9 @@ LIBRARY_DIRS = ['/usr/lib',
 
 extension_mod = Extension('pepy',
                           sources = ['pepy.cpp',
+                                     '../parser-library/arena.cpp',
+                                     '../parser-library/batch.cpp',
+                                     '../parser-library/digest.cpp',
                                      '../parser-library/parse.cpp',
                                      '../parser-library/buffer.cpp'],
                           extra_compile_args = ["-g", "-O0"], # Debug only
@@ -0,0 +1,211 @@
+/*
+The MIT License (MIT)
+
+Copyright (c) 2013 Andrew Ruef
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+
+/*
+ * Checks the bounded_buffer reads at the 4 GiB boundary, where 32 bit
+ * offset and length arithmetic would wrap. The buffer is a sparse mapping
+ * a little past 4 GiB, so only the pages next to the boundary are touched.
+ */
+
+#include "parse.h"
+#include <cstdint>
+#include <cstdio>
+#include <string.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+using namespace peparse;
+
+namespace {
+
+const ::uint64_t FOUR_GB = 0x100000000ULL;
+const ::uint64_t MAP_LEN = FOUR_GB + 0x1000;
+
+int failures = 0;
+
+#define CHECK(c)                                                    \
+  if (!(c)) {                                                       \
+    fprintf(stderr, "%s:%d: failed: %s\n", __FILE__, __LINE__, #c); \
+    failures++;                                                     \
+  }
+
+::uint8_t *mapSparse(::uint64_t len) {
+#ifdef WIN32
+  void *p = VirtualAlloc(nullptr, len, MEM_RESERVE, PAGE_NOACCESS);
+  if (p == nullptr) {
+    return nullptr;
+  }
+
+  // commit only the pages around the boundary
+  ::uint8_t *b = static_cast<::uint8_t *>(p);
+  if (VirtualAlloc(b + FOUR_GB - 0x1000, 0x2000, MEM_COMMIT, PAGE_READWRITE) ==
+      nullptr) {
+    VirtualFree(p, 0, MEM_RELEASE);
+    return nullptr;
+  }
+
+  return b;
+#else
+  void *p = mmap(nullptr,
+                 len,
+                 PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE,
+                 -1,
+                 0);
+  return p == MAP_FAILED ? nullptr : static_cast<::uint8_t *>(p);
+#endif
+}
+
+void unmapSparse(::uint8_t *p, ::uint64_t len) {
+#ifdef WIN32
+  (void) len;
+  VirtualFree(p, 0, MEM_RELEASE);
+#else
+  munmap(p, len);
+#endif
+}
+
+void checkReads(::uint8_t *mem) {
+  // a buffer ending 8 bytes past 4 GiB
+  const ::uint64_t len = FOUR_GB + 8;
+  bounded_buffer *b = makeBufferFromPointer(mem, len);
+  CHECK(b != nullptr);
+  if (b == nullptr) {
+    return;
+  }
+  CHECK(bufLen(b) == len);
+
+  ::uint8_t u8;
+  CHECK(readByte(b, FOUR_GB - 1, u8) && u8 == 0xFF);
+  CHECK(readByte(b, FOUR_GB, u8) && u8 == 0x00);
+  CHECK(readByte(b, len - 1, u8) && u8 == 0x07);
+  CHECK(!readByte(b, len, u8));
+
+  // values straddling 4 GiB are read whole
+  ::uint16_t u16;
+  CHECK(readWord(b, FOUR_GB - 1, u16) && u16 == 0x00FF);
+  CHECK(readWord(b, len - 2, u16) && u16 == 0x0706);
+  CHECK(!readWord(b, len - 1, u16));
+
+  ::uint32_t u32;
+  CHECK(readDword(b, FOUR_GB - 2, u32) && u32 == 0x0100FFFE);
+  CHECK(readDword(b, len - 4, u32) && u32 == 0x07060504);
+  CHECK(!readDword(b, len - 3, u32));
+
+  ::uint64_t u64;
+  CHECK(readQword(b, FOUR_GB - 4, u64) && u64 == 0x03020100FFFEFDFCULL);
+  CHECK(readQword(b, FOUR_GB, u64) && u64 == 0x0706050403020100ULL);
+  CHECK(!readQword(b, FOUR_GB + 1, u64));
+
+  // offsets whose end wraps around 64 bits
+  CHECK(!readWord(b, UINT64_MAX, u16));
+  CHECK(!readDword(b, UINT64_MAX - 1, u32));
+  CHECK(!readQword(b, UINT64_MAX - 3, u64));
+
+  // the 32 bit truncations of out of bounds offsets are in bounds, so a
+  // read that wrapped would succeed here
+  CHECK(!readDword(b, FOUR_GB + len, u32));
+  CHECK(!readByte(b, 2 * FOUR_GB, u8));
+
+  // readFields takes one bounds check for the whole run
+  const field_desc dwords[] = {{0, 4, 1}, {0, 0, 0}};
+  ::uint32_t pair[2];
+  CHECK(readFields(b, FOUR_GB - 4, pair, 8, 4, dwords) &&
+        pair[0] == 0xFFFEFDFC && pair[1] == 0x03020100);
+  CHECK(readFields(b, len - 8, pair, 8, 4, dwords));
+  CHECK(!readFields(b, len - 7, pair, 8, 4, dwords));
+  CHECK(!readFields(b, len + 1, pair, 0, 4, dwords));
+  CHECK(!readFields(b, UINT64_MAX - 3, pair, 8, 4, dwords));
+
+  b->swapBytes = true;
+  CHECK(readDword(b, FOUR_GB - 2, u32) && u32 == 0xFEFF0001);
+  CHECK(readFields(b, FOUR_GB - 4, pair, 8, 4, dwords) &&
+        pair[0] == 0xFCFDFEFF && pair[1] == 0x00010203);
+  b->swapBytes = false;
+
+  // splitting keeps 64 bit bounds
+  bounded_buffer *s = splitBuffer(b, FOUR_GB - 4, len);
+  CHECK(s != nullptr);
+  if (s != nullptr) {
+    CHECK(bufLen(s) == 12);
+    CHECK(readDword(s, 0, u32) && u32 == 0xFFFEFDFC);
+    CHECK(readDword(s, 8, u32) && u32 == 0x07060504);
+    CHECK(!readDword(s, 9, u32));
+    deleteBuffer(s);
+  }
+  CHECK(splitBuffer(b, FOUR_GB, len + 1) == nullptr);
+  CHECK(splitBuffer(b, FOUR_GB + 1, FOUR_GB) == nullptr);
+
+  s = splitBuffer(b, 0, FOUR_GB);
+  CHECK(s != nullptr);
+  if (s != nullptr) {
+    CHECK(bufLen(s) == FOUR_GB);
+    CHECK(readDword(s, FOUR_GB - 4, u32) && u32 == 0xFFFEFDFC);
+    CHECK(!readDword(s, FOUR_GB - 3, u32));
+    CHECK(!readByte(s, FOUR_GB, u8));
+    deleteBuffer(s);
+  }
+
+  deleteBuffer(b);
+}
+
+} // anonymous namespace
+
+int main() {
+  if (sizeof(void *) < 8) {
+    printf("skipped, needs a 64 bit address space\n");
+    return 0;
+  }
+
+  ::uint8_t *mem = mapSparse(MAP_LEN);
+  if (mem == nullptr) {
+    printf("skipped, can't reserve %llu bytes\n",
+           static_cast<unsigned long long>(MAP_LEN));
+    return 0;
+  }
+
+  // the bytes below 4 GiB count down to it, the ones past it count up
+  for (unsigned i = 1; i <= 8; i++) {
+    mem[FOUR_GB - i] = static_cast<::uint8_t>(0x100 - i);
+  }
+  for (unsigned i = 0; i < 8; i++) {
+    mem[FOUR_GB + i] = static_cast<::uint8_t>(i);
+  }
+
+  checkReads(mem);
+  unmapSparse(mem, MAP_LEN);
+
+  if (failures != 0) {
+    fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+
+  printf("all checks passed\n");
+  return 0;
+}